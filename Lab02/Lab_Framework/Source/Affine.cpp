@@ -0,0 +1,51 @@
+//
+// COMP 371 Labs Framework
+//
+// 3x4 affine transforms -- COMP371 Assignment 2
+
+#include "Affine.h"
+
+using namespace glm;
+
+
+void multiplyAffineBatch(const mat4& viewProjection, const Affine3x4* worlds, size_t count, mat4* results)
+{
+#if LIGMA_AFFINE_SSE
+    __m128 c0 = _mm_loadu_ps(&viewProjection[0].x);
+    __m128 c1 = _mm_loadu_ps(&viewProjection[1].x);
+    __m128 c2 = _mm_loadu_ps(&viewProjection[2].x);
+    __m128 c3 = _mm_loadu_ps(&viewProjection[3].x);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        __m128 r0 = _mm_loadu_ps(&worlds[i].rows[0].x);
+        __m128 r1 = _mm_loadu_ps(&worlds[i].rows[1].x);
+        __m128 r2 = _mm_loadu_ps(&worlds[i].rows[2].x);
+        float* result = &results[i][0].x;
+
+        // column j of the product is c0 * r0[j] + c1 * r1[j] + c2 * r2[j], plus c3 for the translation
+#define LIGMA_AFFINE_COLUMN(j) \
+        _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, _mm_shuffle_ps(r0, r0, _MM_SHUFFLE(j, j, j, j))), \
+                              _mm_mul_ps(c1, _mm_shuffle_ps(r1, r1, _MM_SHUFFLE(j, j, j, j)))), \
+                              _mm_mul_ps(c2, _mm_shuffle_ps(r2, r2, _MM_SHUFFLE(j, j, j, j))))
+
+        _mm_storeu_ps(result, LIGMA_AFFINE_COLUMN(0));
+        _mm_storeu_ps(result + 4, LIGMA_AFFINE_COLUMN(1));
+        _mm_storeu_ps(result + 8, LIGMA_AFFINE_COLUMN(2));
+        _mm_storeu_ps(result + 12, _mm_add_ps(LIGMA_AFFINE_COLUMN(3), c3));
+#undef LIGMA_AFFINE_COLUMN
+    }
+#else
+    for (size_t i = 0; i < count; ++i)
+    {
+        const Affine3x4& world = worlds[i];
+        for (int column = 0; column < 4; ++column)
+        {
+            results[i][column] = viewProjection[0] * world.rows[0][column]
+                               + viewProjection[1] * world.rows[1][column]
+                               + viewProjection[2] * world.rows[2][column];
+        }
+        results[i][3] += viewProjection[3];
+    }
+#endif
+}
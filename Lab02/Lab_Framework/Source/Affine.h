@@ -0,0 +1,147 @@
+//
+// COMP 371 Labs Framework
+//
+// 3x4 affine transforms -- COMP371 Assignment 2
+//
+// A world transform's last row is always (0, 0, 0, 1), so only the top three rows
+// are kept, each one a vec4 of (x axis, y axis, z axis, translation) components.
+// That is 48 bytes instead of 64 in every uniform, instance attribute and storage
+// buffer. Read as column-major data the three rows are exactly a GLSL mat3x4, and
+// a shader expands a point with vec4(position, 1.0) * worldMatrix.
+//
+// Multiply and point/vector transforms use SSE when the compiler targets it,
+// with unaligned loads since glm does not align its vectors.
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "Transform.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LIGMA_AFFINE_SSE 1
+#include <emmintrin.h>
+#else
+#define LIGMA_AFFINE_SSE 0
+#endif
+
+
+struct Affine3x4
+{
+    glm::vec4 rows[3];
+};
+
+
+inline Affine3x4 affineIdentity()
+{
+    Affine3x4 result;
+    result.rows[0] = glm::vec4(1.0f, 0.0f, 0.0f, 0.0f);
+    result.rows[1] = glm::vec4(0.0f, 1.0f, 0.0f, 0.0f);
+    result.rows[2] = glm::vec4(0.0f, 0.0f, 1.0f, 0.0f);
+    return result;
+}
+
+// Drops the last row, which has to be (0, 0, 0, 1)
+inline Affine3x4 toAffine(const glm::mat4& matrix)
+{
+    Affine3x4 result;
+    for (int row = 0; row < 3; ++row)
+        result.rows[row] = glm::vec4(matrix[0][row], matrix[1][row], matrix[2][row], matrix[3][row]);
+    return result;
+}
+
+inline glm::mat4 toMat4(const Affine3x4& affine)
+{
+    glm::mat4 result;
+    for (int column = 0; column < 4; ++column)
+        result[column] = glm::vec4(affine.rows[0][column], affine.rows[1][column], affine.rows[2][column], column == 3 ? 1.0f : 0.0f);
+    return result;
+}
+
+// Same fused T * R * S as toMatrix(), written as rows
+inline Affine3x4 toAffine(const Transform& transform)
+{
+    const glm::quat& q = transform.rotation;
+    const glm::vec3& s = transform.scale;
+    float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+    float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+    float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+
+    Affine3x4 result;
+    result.rows[0] = glm::vec4((1.0f - 2.0f * (yy + zz)) * s.x, 2.0f * (xy - wz) * s.y, 2.0f * (xz + wy) * s.z, transform.translation.x);
+    result.rows[1] = glm::vec4(2.0f * (xy + wz) * s.x, (1.0f - 2.0f * (xx + zz)) * s.y, 2.0f * (yz - wx) * s.z, transform.translation.y);
+    result.rows[2] = glm::vec4(2.0f * (xz - wy) * s.x, 2.0f * (yz + wx) * s.y, (1.0f - 2.0f * (xx + yy)) * s.z, transform.translation.z);
+    return result;
+}
+
+inline glm::vec3 affineTranslation(const Affine3x4& affine)
+{
+    return glm::vec3(affine.rows[0].w, affine.rows[1].w, affine.rows[2].w);
+}
+
+
+// a * b, b applied first
+inline Affine3x4 operator*(const Affine3x4& a, const Affine3x4& b)
+{
+    Affine3x4 result;
+#if LIGMA_AFFINE_SSE
+    __m128 b0 = _mm_loadu_ps(&b.rows[0].x);
+    __m128 b1 = _mm_loadu_ps(&b.rows[1].x);
+    __m128 b2 = _mm_loadu_ps(&b.rows[2].x);
+    __m128 translationMask = _mm_castsi128_ps(_mm_set_epi32(-1, 0, 0, 0));
+
+    for (int row = 0; row < 3; ++row)
+    {
+        // a_row.x * b0 + a_row.y * b1 + a_row.z * b2 + (0, 0, 0, a_row.w)
+        __m128 r = _mm_loadu_ps(&a.rows[row].x);
+        __m128 sum = _mm_mul_ps(_mm_shuffle_ps(r, r, _MM_SHUFFLE(0, 0, 0, 0)), b0);
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_shuffle_ps(r, r, _MM_SHUFFLE(1, 1, 1, 1)), b1));
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_shuffle_ps(r, r, _MM_SHUFFLE(2, 2, 2, 2)), b2));
+        sum = _mm_add_ps(sum, _mm_and_ps(r, translationMask));
+        _mm_storeu_ps(&result.rows[row].x, sum);
+    }
+#else
+    for (int row = 0; row < 3; ++row)
+    {
+        const glm::vec4& r = a.rows[row];
+        result.rows[row] = r.x * b.rows[0] + r.y * b.rows[1] + r.z * b.rows[2] + glm::vec4(0.0f, 0.0f, 0.0f, r.w);
+    }
+#endif
+    return result;
+}
+
+
+// w = 1 picks up the translation, w = 0 does not
+inline glm::vec3 affineTransform(const Affine3x4& affine, const glm::vec4& v)
+{
+#if LIGMA_AFFINE_SSE
+    __m128 x = _mm_loadu_ps(&v.x);
+    __m128 r0 = _mm_mul_ps(_mm_loadu_ps(&affine.rows[0].x), x);
+    __m128 r1 = _mm_mul_ps(_mm_loadu_ps(&affine.rows[1].x), x);
+    __m128 r2 = _mm_mul_ps(_mm_loadu_ps(&affine.rows[2].x), x);
+    __m128 r3 = _mm_setzero_ps();
+
+    // the three dot products at once: transpose and add the columns up
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    float lanes[4];
+    _mm_storeu_ps(lanes, _mm_add_ps(_mm_add_ps(r0, r1), _mm_add_ps(r2, r3)));
+    return glm::vec3(lanes[0], lanes[1], lanes[2]);
+#else
+    return glm::vec3(glm::dot(affine.rows[0], v), glm::dot(affine.rows[1], v), glm::dot(affine.rows[2], v));
+#endif
+}
+
+inline glm::vec3 transformPoint(const Affine3x4& affine, const glm::vec3& point)
+{
+    return affineTransform(affine, glm::vec4(point, 1.0f));
+}
+
+inline glm::vec3 transformVector(const Affine3x4& affine, const glm::vec3& vector)
+{
+    return affineTransform(affine, glm::vec4(vector, 0.0f));
+}
+
+
+// results[i] = viewProjection * worlds[i] for a whole batch, the view-projection
+// columns stay in registers across the loop
+void multiplyAffineBatch(const glm::mat4& viewProjection, const Affine3x4* worlds, size_t count, glm::mat4* results);
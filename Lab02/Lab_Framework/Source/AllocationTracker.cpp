@@ -0,0 +1,499 @@
+//
+// COMP 371 Labs Framework
+//
+// Heap allocation tracking -- COMP371 Assignment 2
+
+#include "AllocationTracker.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <new>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <dbghelp.h>
+#pragma comment(lib, "dbghelp.lib")
+#else
+#include <execinfo.h>
+#include <unistd.h>
+#endif
+
+
+namespace AllocationTracker
+{
+    // One named set of counters, for a thread or a scope. Everything here is plain
+    // storage so the operators below never allocate while counting.
+    struct Counter
+    {
+        const char* name;
+        std::atomic<unsigned long long> allocations;
+        std::atomic<unsigned long long> bytes;
+        AllocationCounts frameStart;
+        AllocationCounts lastFrame;
+    };
+
+    struct Offender
+    {
+        unsigned int frame;
+        size_t size;
+        int scope;
+        int depth;
+        void* stack[MaxStackDepth];
+    };
+
+    static Counter sThreads[MaxThreads];
+    static std::atomic<int> sThreadCount(0);
+    static Counter sScopes[MaxScopes];
+    static std::atomic<int> sScopeCount(0);
+    static std::mutex sScopeMutex;
+
+    static std::atomic<unsigned long long> sAllocations(0);
+    static std::atomic<unsigned long long> sBytes(0);
+    static AllocationCounts sFrameStart;
+    static AllocationCounts sLastFrame;
+
+    static std::atomic<bool> sStrict(false);
+    static std::atomic<unsigned int> sFrameNumber(0);     // endFrame() moves it on, other threads read it
+    static std::atomic<unsigned int> sOffendingFrames(0);
+    static Offender sOffenders[MaxOffenders];
+    static std::atomic<int> sOffenderCount(0);
+
+    static thread_local int tThread = -1;
+    static thread_local int tScope = -1;
+    static thread_local bool tInFrame = false;
+    static thread_local AllocationCounts tFrameStart;     // beginThreadFrame() only
+    static thread_local bool tBusy = false;    // capturing a stack may allocate itself
+
+
+    static AllocationCounts readCounter(const Counter& counter)
+    {
+        AllocationCounts counts = { counter.allocations.load(std::memory_order_relaxed), counter.bytes.load(std::memory_order_relaxed) };
+        return counts;
+    }
+
+    static AllocationCounts difference(const AllocationCounts& now, const AllocationCounts& start)
+    {
+        AllocationCounts counts = { now.allocations - start.allocations, now.bytes - start.bytes };
+        return counts;
+    }
+
+    static int threadSlot()
+    {
+        if (tThread < 0)
+        {
+            int slot = sThreadCount.fetch_add(1);
+            tThread = slot < MaxThreads ? slot : MaxThreads; // past the table the thread is only counted in total
+            if (slot < MaxThreads)
+                sThreads[slot].name = "unnamed thread";
+        }
+        return tThread;
+    }
+
+    static int captureStack(void** stack, int maxDepth)
+    {
+#ifdef _WIN32
+        return CaptureStackBackTrace(2, (DWORD)maxDepth, stack, NULL);
+#else
+        return backtrace(stack, maxDepth);
+#endif
+    }
+
+
+    static void recordAllocation(size_t size)
+    {
+        if (tBusy)
+            return;
+
+        sAllocations.fetch_add(1, std::memory_order_relaxed);
+        sBytes.fetch_add(size, std::memory_order_relaxed);
+
+        int thread = threadSlot();
+        if (thread < MaxThreads)
+        {
+            sThreads[thread].allocations.fetch_add(1, std::memory_order_relaxed);
+            sThreads[thread].bytes.fetch_add(size, std::memory_order_relaxed);
+        }
+        if (tScope >= 0)
+        {
+            sScopes[tScope].allocations.fetch_add(1, std::memory_order_relaxed);
+            sScopes[tScope].bytes.fetch_add(size, std::memory_order_relaxed);
+        }
+
+        if (!tInFrame || !sStrict.load(std::memory_order_relaxed))
+            return;
+
+        int index = sOffenderCount.fetch_add(1);
+        if (index >= MaxOffenders)
+            return;
+
+        Offender& offender = sOffenders[index];
+        offender.frame = sFrameNumber.load(std::memory_order_relaxed);
+        offender.size = size;
+        offender.scope = tScope;
+        tBusy = true;
+        offender.depth = captureStack(offender.stack, MaxStackDepth);
+        tBusy = false;
+    }
+
+
+    static void countOffendingFrame(const char* threadName, const AllocationCounts& frame)
+    {
+        if (sOffendingFrames.fetch_add(1) == 0)
+        {
+            printf("AllocationTracker: frame %u allocated %llu times (%llu bytes) on the %s thread\n", sFrameNumber.load(),
+                   frame.allocations, frame.bytes, threadName);
+        }
+    }
+
+
+    void setThreadName(const char* name)
+    {
+        int thread = threadSlot();
+        if (thread < MaxThreads)
+            sThreads[thread].name = name;
+    }
+
+
+    void beginFrame()
+    {
+        tInFrame = true;
+        sFrameStart.allocations = sAllocations.load();
+        sFrameStart.bytes = sBytes.load();
+
+        int threadCount = sThreadCount.load() < MaxThreads ? sThreadCount.load() : MaxThreads;
+        for (int i = 0; i < threadCount; ++i)
+            sThreads[i].frameStart = readCounter(sThreads[i]);
+        for (int i = 0; i < sScopeCount.load(); ++i)
+            sScopes[i].frameStart = readCounter(sScopes[i]);
+    }
+
+
+    void endFrame()
+    {
+        tInFrame = false;
+        AllocationCounts now = { sAllocations.load(), sBytes.load() };
+        sLastFrame = difference(now, sFrameStart);
+
+        int threadCount = sThreadCount.load() < MaxThreads ? sThreadCount.load() : MaxThreads;
+        for (int i = 0; i < threadCount; ++i)
+            sThreads[i].lastFrame = difference(readCounter(sThreads[i]), sThreads[i].frameStart);
+        for (int i = 0; i < sScopeCount.load(); ++i)
+            sScopes[i].lastFrame = difference(readCounter(sScopes[i]), sScopes[i].frameStart);
+
+        if (sStrict && tThread >= 0 && tThread < MaxThreads && sThreads[tThread].lastFrame.allocations > 0)
+            countOffendingFrame(sThreads[tThread].name, sThreads[tThread].lastFrame);
+        sFrameNumber++;
+    }
+
+
+    void beginThreadFrame()
+    {
+        tInFrame = true;
+        int thread = threadSlot();
+        if (thread < MaxThreads)
+            tFrameStart = readCounter(sThreads[thread]);
+    }
+
+
+    void endThreadFrame()
+    {
+        tInFrame = false;
+        int thread = threadSlot();
+        if (thread >= MaxThreads)
+            return;
+
+        AllocationCounts frame = difference(readCounter(sThreads[thread]), tFrameStart);
+        if (sStrict && frame.allocations > 0)
+            countOffendingFrame(sThreads[thread].name, frame);
+    }
+
+
+    void setStrict(bool strict)
+    {
+        sStrict = strict;
+    }
+
+
+    bool isStrict()
+    {
+        return sStrict;
+    }
+
+
+    unsigned int offendingFrames()
+    {
+        return sOffendingFrames;
+    }
+
+
+    AllocationCounts lastFrame()
+    {
+        return sLastFrame;
+    }
+
+
+    static void printStack(const Offender& offender)
+    {
+#ifdef _WIN32
+        HANDLE process = GetCurrentProcess();
+        static bool symbolsLoaded = false;
+        if (!symbolsLoaded)
+        {
+            SymInitialize(process, NULL, TRUE);
+            symbolsLoaded = true;
+        }
+
+        char symbolStorage[sizeof(SYMBOL_INFO) + 256];
+        SYMBOL_INFO* symbol = (SYMBOL_INFO*)symbolStorage;
+        for (int i = 0; i < offender.depth; ++i)
+        {
+            memset(symbolStorage, 0, sizeof(symbolStorage));
+            symbol->SizeOfStruct = sizeof(SYMBOL_INFO);
+            symbol->MaxNameLen = 255;
+
+            DWORD64 address = (DWORD64)offender.stack[i];
+            IMAGEHLP_LINE64 line;
+            memset(&line, 0, sizeof(line));
+            line.SizeOfStruct = sizeof(line);
+            DWORD displacement = 0;
+            if (SymFromAddr(process, address, NULL, symbol) && SymGetLineFromAddr64(process, address, &displacement, &line))
+                printf("        %s  %s:%lu\n", symbol->Name, line.FileName, (unsigned long)line.LineNumber);
+            else if (SymFromAddr(process, address, NULL, symbol))
+                printf("        %s\n", symbol->Name);
+            else
+                printf("        %p\n", offender.stack[i]);
+        }
+#else
+        // straight to stdout, backtrace_symbols would allocate
+        fflush(stdout);
+        backtrace_symbols_fd(offender.stack, offender.depth, STDOUT_FILENO);
+#endif
+    }
+
+
+    void report()
+    {
+        tBusy = true;
+
+        printf("Allocations: %llu (%llu bytes) in total, %llu (%llu bytes) in the last frame\n",
+               sAllocations.load(), sBytes.load(), sLastFrame.allocations, sLastFrame.bytes);
+
+        int threadCount = sThreadCount.load() < MaxThreads ? sThreadCount.load() : MaxThreads;
+        for (int i = 0; i < threadCount; ++i)
+        {
+            AllocationCounts total = readCounter(sThreads[i]);
+            printf("    thread %-24s %10llu allocations %12llu bytes, last frame %llu\n", sThreads[i].name,
+                   total.allocations, total.bytes, sThreads[i].lastFrame.allocations);
+        }
+        for (int i = 0; i < sScopeCount.load(); ++i)
+        {
+            AllocationCounts total = readCounter(sScopes[i]);
+            printf("    scope  %-24s %10llu allocations %12llu bytes, last frame %llu\n", sScopes[i].name,
+                   total.allocations, total.bytes, sScopes[i].lastFrame.allocations);
+        }
+
+        if (sStrict || sOffendingFrames > 0)
+            printf("%u frames allocated on a frame thread while strict\n", sOffendingFrames.load());
+
+        int offenderCount = sOffenderCount.load() < MaxOffenders ? sOffenderCount.load() : MaxOffenders;
+        for (int i = 0; i < offenderCount; ++i)
+        {
+            const Offender& offender = sOffenders[i];
+            printf("    frame %u, %u bytes%s%s:\n", offender.frame, (unsigned int)offender.size,
+                   offender.scope >= 0 ? " in scope " : "", offender.scope >= 0 ? sScopes[offender.scope].name : "");
+            printStack(offender);
+        }
+
+        fflush(stdout);
+        tBusy = false;
+    }
+}
+
+
+AllocationScope::AllocationScope(const char* name)
+    : mPrevious(AllocationTracker::tScope)
+{
+    using namespace AllocationTracker;
+
+    // scopes are few and looked up by pointer, registering takes the lock once per name
+    int count = sScopeCount.load();
+    int scope = -1;
+    for (int i = 0; i < count && scope < 0; ++i)
+    {
+        if (sScopes[i].name == name)
+            scope = i;
+    }
+
+    if (scope < 0)
+    {
+        std::lock_guard<std::mutex> lock(sScopeMutex);
+        count = sScopeCount.load();
+        for (int i = 0; i < count && scope < 0; ++i)
+        {
+            if (sScopes[i].name == name)
+                scope = i;
+        }
+        if (scope < 0 && count < MaxScopes)
+        {
+            sScopes[count].name = name;
+            scope = count;
+            sScopeCount.store(count + 1);
+        }
+    }
+
+    // past MaxScopes the allocations stay with the enclosing scope
+    if (scope >= 0)
+        tScope = scope;
+}
+
+
+AllocationScope::~AllocationScope()
+{
+    AllocationTracker::tScope = mPrevious;
+}
+
+
+#if LIGMA_ALLOCATION_TRACKING
+
+void* operator new(size_t size)
+{
+    AllocationTracker::recordAllocation(size);
+    void* pointer = malloc(size > 0 ? size : 1);
+    if (pointer == NULL)
+        throw std::bad_alloc();
+    return pointer;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    AllocationTracker::recordAllocation(size);
+    return malloc(size > 0 ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    return operator new(size, std::nothrow);
+}
+
+void operator delete(void* pointer) noexcept
+{
+    free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+    free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept
+{
+    free(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept
+{
+    free(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept
+{
+    free(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept
+{
+    free(pointer);
+}
+
+// Over-aligned types (alignas above 16, e.g. cache line padded atomics) use these from C++17 on
+#ifdef __cpp_aligned_new
+
+static void* alignedAllocate(size_t size, size_t alignment)
+{
+    if (size == 0)
+        size = 1;
+#ifdef _WIN32
+    return _aligned_malloc(size, alignment);
+#else
+    void* pointer = NULL;
+    return posix_memalign(&pointer, alignment < sizeof(void*) ? sizeof(void*) : alignment, size) == 0 ? pointer : NULL;
+#endif
+}
+
+static void alignedFree(void* pointer)
+{
+#ifdef _WIN32
+    _aligned_free(pointer);
+#else
+    free(pointer);
+#endif
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    AllocationTracker::recordAllocation(size);
+    void* pointer = alignedAllocate(size, (size_t)alignment);
+    if (pointer == NULL)
+        throw std::bad_alloc();
+    return pointer;
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+    return operator new(size, alignment);
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    AllocationTracker::recordAllocation(size);
+    return alignedAllocate(size, (size_t)alignment);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return operator new(size, alignment, std::nothrow);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept
+{
+    alignedFree(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t) noexcept
+{
+    alignedFree(pointer);
+}
+
+void operator delete(void* pointer, size_t, std::align_val_t) noexcept
+{
+    alignedFree(pointer);
+}
+
+void operator delete[](void* pointer, size_t, std::align_val_t) noexcept
+{
+    alignedFree(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    alignedFree(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    alignedFree(pointer);
+}
+
+#endif
+
+#endif
@@ -0,0 +1,79 @@
+//
+// COMP 371 Labs Framework
+//
+// Heap allocation tracking -- COMP371 Assignment 2
+//
+// Replaces the global operator new / delete, and their aligned forms where the
+// compiler has them, so every C++ heap allocation is counted, in total, per thread
+// and per tagged AllocationScope, and summed per frame between beginFrame() and
+// endFrame(). In strict mode any allocation the frame thread, or a thread
+// bracketing its own frames with beginThreadFrame(), makes inside a frame is an
+// offence: its call stack is captured (the first MaxOffenders of them) and the
+// frame is counted, which is how benchmarks prove the steady-state loop never
+// allocates. Compile with LIGMA_ALLOCATION_TRACKING=0 to leave the global
+// operators alone; malloc and allocations inside drivers are never seen.
+
+#pragma once
+
+#include <cstddef>
+
+#ifndef LIGMA_ALLOCATION_TRACKING
+#define LIGMA_ALLOCATION_TRACKING 1
+#endif
+
+
+struct AllocationCounts
+{
+    unsigned long long allocations;
+    unsigned long long bytes;
+};
+
+
+namespace AllocationTracker
+{
+    static const int MaxThreads = 16;
+    static const int MaxScopes = 32;
+    static const int MaxOffenders = 8;
+    static const int MaxStackDepth = 24;
+
+    // Names the calling thread in the report
+    void setThreadName(const char* name);
+
+    // Bracket the frame on the thread that runs the main loop, which becomes the frame thread
+    void beginFrame();
+    void endFrame();
+
+    // Bracket one frame's work on another thread, e.g. the render thread; only that
+    // thread's allocations count against it, and offend the same way when strict
+    void beginThreadFrame();
+    void endThreadFrame();
+
+    // Frame thread allocations inside a frame are offences from now on
+    void setStrict(bool strict);
+    bool isStrict();
+
+    // Frames that allocated on a frame thread while strict
+    unsigned int offendingFrames();
+
+    // Every thread, last finished frame
+    AllocationCounts lastFrame();
+
+    // Counts, scopes, threads and the captured offender stacks
+    void report();
+}
+
+
+// Allocations on this thread are also counted under name until the scope closes.
+// name has to be a string literal, scopes are told apart by pointer.
+class AllocationScope
+{
+public:
+    explicit AllocationScope(const char* name);
+    ~AllocationScope();
+
+private:
+    AllocationScope(const AllocationScope&);
+    AllocationScope& operator=(const AllocationScope&);
+
+    int mPrevious;
+};
@@ -0,0 +1,102 @@
+//
+// COMP 371 Labs Framework
+//
+// Entity components -- COMP371 Assignment 2
+//
+// Plain data only, every component is stored in its own tightly packed array per
+// archetype and moved around with memcpy. Systems touch the small hot components
+// every frame; cold ones like SpawnComponent are only read on rare events, so they
+// never share cache lines with the hot data.
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "Affine.h"
+
+#include <cstddef>
+
+
+enum ComponentType
+{
+    COMPONENT_TRANSFORM = 0,
+    COMPONENT_WORLD_BOUNDS,
+    COMPONENT_RENDERABLE,
+    COMPONENT_VISIBILITY,
+    COMPONENT_ANIMATION,
+    COMPONENT_SPAWN,
+
+    COMPONENT_TYPE_COUNT
+};
+
+typedef unsigned int ComponentMask;
+
+inline ComponentMask componentBit(ComponentType type) { return 1u << type; }
+
+
+// Position on the ground, turn around z and uniform size
+struct TransformComponent
+{
+    glm::vec3 position;
+    float yaw;
+    float scale;
+    unsigned int dirty;     // world bounds need recomputing
+};
+
+// Output of the transform system
+struct WorldBoundsComponent
+{
+    Affine3x4 worldMatrix;
+    glm::vec4 bounds;       // world space bounding sphere, xyz center and w radius
+};
+
+struct RenderableComponent
+{
+    unsigned int mesh;      // MeshId
+};
+
+// Output of the culling system
+struct VisibilityComponent
+{
+    unsigned int visible;
+};
+
+// Spins the entity in place
+struct AnimationComponent
+{
+    float turnSpeed;        // radians per second
+};
+
+// Where the entity started, cold
+struct SpawnComponent
+{
+    glm::vec3 position;
+    float yaw;
+    float scale;
+};
+
+
+template <typename T> struct ComponentTraits;
+
+template <> struct ComponentTraits<TransformComponent>   { static const ComponentType Type = COMPONENT_TRANSFORM; };
+template <> struct ComponentTraits<WorldBoundsComponent> { static const ComponentType Type = COMPONENT_WORLD_BOUNDS; };
+template <> struct ComponentTraits<RenderableComponent>  { static const ComponentType Type = COMPONENT_RENDERABLE; };
+template <> struct ComponentTraits<VisibilityComponent>  { static const ComponentType Type = COMPONENT_VISIBILITY; };
+template <> struct ComponentTraits<AnimationComponent>   { static const ComponentType Type = COMPONENT_ANIMATION; };
+template <> struct ComponentTraits<SpawnComponent>       { static const ComponentType Type = COMPONENT_SPAWN; };
+
+template <typename T> inline ComponentMask componentBit() { return componentBit(ComponentTraits<T>::Type); }
+
+
+inline size_t componentSize(ComponentType type)
+{
+    static const size_t sizes[COMPONENT_TYPE_COUNT] = {
+        sizeof(TransformComponent),
+        sizeof(WorldBoundsComponent),
+        sizeof(RenderableComponent),
+        sizeof(VisibilityComponent),
+        sizeof(AnimationComponent),
+        sizeof(SpawnComponent)
+    };
+    return sizes[type];
+}
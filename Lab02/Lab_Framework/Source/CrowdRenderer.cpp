@@ -0,0 +1,451 @@
+//
+// COMP 371 Labs Framework
+//
+// Instanced crowd rendering with frustum culling -- COMP371 Assignment 2
+
+#include "CrowdRenderer.h"
+#include "Frustum.h"
+#include "GLStats.h"
+#include "RenderQueue.h"
+#include "SceneShader.h"
+#include "StreamBuffer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+using namespace glm;
+
+
+static const char* getCullComputeShaderSource()
+{
+    return
+        "#version 430 core\n"
+        "layout (local_size_x = 64) in;"
+        ""
+        "struct Instance { mat3x4 worldMatrix; vec4 bounds; uint mesh; uint padding0; uint padding1; uint padding2; };"
+        "struct DrawCommand { uint count; uint instanceCount; uint firstIndex; int baseVertex; uint baseInstance; };"
+        ""
+        "layout (std430, binding = 0) readonly buffer Instances { Instance instances[]; };"
+        "layout (std430, binding = 1) buffer Commands { DrawCommand commands[]; };"
+        "layout (std430, binding = 2) writeonly buffer Visible { uint visibleInstances[]; };"
+        ""
+        "uniform vec4 frustumPlanes[6];"
+        "uniform uint instanceCount;"
+        ""
+        "void main()"
+        "{"
+        "   uint id = gl_GlobalInvocationID.x;"
+        "   if (id >= instanceCount)"
+        "       return;"
+        ""
+        "   vec4 bounds = instances[id].bounds;"
+        "   for (int i = 0; i < 6; ++i)"
+        "   {"
+        "       if (dot(frustumPlanes[i].xyz, bounds.xyz) + frustumPlanes[i].w < -bounds.w)"
+        "           return;"
+        "   }"
+        ""
+        "   uint mesh = instances[id].mesh;"
+        "   uint slot = atomicAdd(commands[mesh].instanceCount, 1u);"
+        "   visibleInstances[commands[mesh].baseInstance + slot] = id;"
+        "}";
+}
+
+
+CrowdInstance makeCrowdInstance(const MeshLibrary& meshes, MeshId mesh, const Affine3x4& worldMatrix)
+{
+    const Mesh& source = meshes.mesh(mesh);
+
+    // largest axis scale keeps the sphere conservative under non-uniform scaling
+    float maxScale = max(length(transformVector(worldMatrix, vec3(1.0f, 0.0f, 0.0f))),
+                     max(length(transformVector(worldMatrix, vec3(0.0f, 1.0f, 0.0f))),
+                         length(transformVector(worldMatrix, vec3(0.0f, 0.0f, 1.0f)))));
+
+    CrowdInstance instance;
+    instance.worldMatrix = worldMatrix;
+    instance.bounds = vec4(transformPoint(worldMatrix, source.boundsCenter), source.boundsRadius * maxScale);
+    instance.mesh = mesh;
+    instance.padding[0] = instance.padding[1] = instance.padding[2] = 0;
+    return instance;
+}
+
+
+CrowdRenderer::CrowdRenderer()
+    : mMeshes(NULL), mGpuCulling(false), mAllocatedInstances(0), mLastVisibleCount(0),
+      mCullProgram(0), mGpuDrawProgram(0), mGpuVertexArray(0),
+      mInstanceBuffer(0), mCommandBuffer(0), mVisibleBuffer(0),
+      mFrustumPlanesLocation(-1), mInstanceCountLocation(-1),
+      mCpuDrawProgram(0), mCpuVertexArray(0),
+      mMultiViewProgram(0), mMultiViewVertexArray(0), mMultiViewDivisor(0)
+{
+    for (int i = 0; i < MESH_COUNT; ++i)
+    {
+        mMeshFirstInstance[i] = 0;
+        mMeshInstanceCount[i] = 0;
+    }
+}
+
+
+CrowdRenderer::~CrowdRenderer()
+{
+    destroy();
+}
+
+
+bool CrowdRenderer::create(const MeshLibrary& meshes, ShaderPermutations& sceneShaders, bool gpuCulling)
+{
+    destroy();
+    mMeshes = &meshes;
+
+    // CPU path is always there as the fallback, draw programs belong to the permutations
+    mCpuDrawProgram = sceneShaders.program(SCENE_SHADER_INSTANCE_ATTRIBUTE);
+    if (mCpuDrawProgram == 0)
+        return false;
+
+    glGenVertexArrays(1, &mCpuVertexArray);
+    glBindVertexArray(mCpuVertexArray);
+    meshes.setupVertexAttributes();
+    for (int row = 0; row < 3; ++row)
+    {
+        // pointers are set every frame to wherever the stream buffer put the matrices
+        glEnableVertexAttribArray(3 + row);
+        glVertexAttribDivisor(3 + row, 1);
+    }
+    glBindVertexArray(0);
+
+    if (isMultiViewSupported())
+        mMultiViewProgram = sceneShaders.program(SCENE_SHADER_INSTANCE_ATTRIBUTE | SCENE_SHADER_MULTI_VIEW);
+    if (mMultiViewProgram != 0)
+    {
+        // same layout, the divisor is set once the view count is known
+        glGenVertexArrays(1, &mMultiViewVertexArray);
+        glBindVertexArray(mMultiViewVertexArray);
+        meshes.setupVertexAttributes();
+        for (int row = 0; row < 3; ++row)
+            glEnableVertexAttribArray(3 + row);
+        glBindVertexArray(0);
+        mMultiViewDivisor = 0;
+    }
+
+    mGpuCulling = gpuCulling && GLEW_VERSION_4_3;
+    if (gpuCulling && !mGpuCulling)
+        std::cout << "CrowdRenderer: GPU culling needs OpenGL 4.3, culling on the CPU" << std::endl;
+
+    if (mGpuCulling)
+    {
+        mCullProgram = linkComputeProgram(compileShader(GL_COMPUTE_SHADER, getCullComputeShaderSource()));
+        mGpuDrawProgram = sceneShaders.program(SCENE_SHADER_INSTANCE_STORAGE);
+        if (mCullProgram == 0 || mGpuDrawProgram == 0)
+        {
+            std::cerr << "CrowdRenderer: culling shaders failed, culling on the CPU" << std::endl;
+            mGpuCulling = false;
+        }
+    }
+
+    if (mGpuCulling)
+    {
+        mFrustumPlanesLocation = glGetUniformLocation(mCullProgram, "frustumPlanes");
+        mInstanceCountLocation = glGetUniformLocation(mCullProgram, "instanceCount");
+
+        glGenBuffers(1, &mInstanceBuffer);
+        glGenBuffers(1, &mCommandBuffer);
+        glGenBuffers(1, &mVisibleBuffer);
+
+        glGenVertexArrays(1, &mGpuVertexArray);
+        glBindVertexArray(mGpuVertexArray);
+        meshes.setupVertexAttributes();
+        glBindBuffer(GL_ARRAY_BUFFER, mVisibleBuffer);
+        glVertexAttribIPointer(2, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)0);
+        glVertexAttribDivisor(2, 1);
+        glEnableVertexAttribArray(2);
+        glBindVertexArray(0);
+    }
+
+    return true;
+}
+
+
+void CrowdRenderer::destroy()
+{
+    if (mCullProgram != 0)
+        glDeleteProgram(mCullProgram);
+    if (mGpuVertexArray != 0)
+        glDeleteVertexArrays(1, &mGpuVertexArray);
+    if (mCpuVertexArray != 0)
+        glDeleteVertexArrays(1, &mCpuVertexArray);
+    if (mMultiViewVertexArray != 0)
+        glDeleteVertexArrays(1, &mMultiViewVertexArray);
+
+    GLuint buffers[] = { mInstanceBuffer, mCommandBuffer, mVisibleBuffer };
+    for (int i = 0; i < 3; ++i)
+    {
+        if (buffers[i] != 0)
+            glDeleteBuffers(1, &buffers[i]);
+    }
+
+    mCullProgram = mGpuDrawProgram = mCpuDrawProgram = 0;
+    mGpuVertexArray = mCpuVertexArray = mMultiViewVertexArray = 0;
+    mMultiViewProgram = 0;
+    mInstanceBuffer = mCommandBuffer = mVisibleBuffer = 0;
+    mInstances.clear();
+    mInstanceSlots.clear();
+    mAllocatedInstances = 0;
+    mGpuCulling = false;
+}
+
+
+void CrowdRenderer::setInstances(const CrowdInstance* instances, size_t count)
+{
+    for (int mesh = 0; mesh < MESH_COUNT; ++mesh)
+        mMeshInstanceCount[mesh] = 0;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        // one glMultiDrawElementsIndirect has one primitive mode
+        if (instances[i].mesh >= MESH_COUNT || mMeshes->mesh((MeshId)instances[i].mesh).mode != GL_TRIANGLES)
+        {
+            std::cerr << "CrowdRenderer: instance " << i << " does not use a triangle mesh, skipped" << std::endl;
+            continue;
+        }
+        mMeshInstanceCount[instances[i].mesh]++;
+    }
+
+    GLuint firstInstance = 0;
+    for (int mesh = 0; mesh < MESH_COUNT; ++mesh)
+    {
+        mMeshFirstInstance[mesh] = firstInstance;
+        firstInstance += mMeshInstanceCount[mesh];
+    }
+
+    // grouping by mesh gives every mesh a contiguous range of the visible list; a counting
+    // scatter keeps the order inside each mesh and needs no sort buffer
+    GLuint written[MESH_COUNT];
+    for (int mesh = 0; mesh < MESH_COUNT; ++mesh)
+        written[mesh] = mMeshFirstInstance[mesh];
+
+    mInstances.resize(firstInstance);
+    mInstanceSlots.resize(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        mInstanceSlots[i] = ~0u;
+        if (instances[i].mesh < MESH_COUNT && mMeshes->mesh((MeshId)instances[i].mesh).mode == GL_TRIANGLES)
+        {
+            mInstanceSlots[i] = written[instances[i].mesh]++;
+            mInstances[mInstanceSlots[i]] = instances[i];
+        }
+    }
+
+    if (!mGpuCulling)
+        return;
+
+    mCommandTemplate.resize(MESH_COUNT);
+    for (int mesh = 0; mesh < MESH_COUNT; ++mesh)
+    {
+        const Mesh& source = mMeshes->mesh((MeshId)mesh);
+        DrawElementsIndirectCommand& command = mCommandTemplate[mesh];
+        command.count = mMeshInstanceCount[mesh] > 0 ? source.indexCount : 0;
+        command.instanceCount = 0;
+        command.firstIndex = source.firstIndex;
+        command.baseVertex = source.baseVertex;
+        command.baseInstance = mMeshFirstInstance[mesh];
+    }
+
+    // Same count, same sizes: the buffers are written in place instead of reallocated
+    const bool reallocate = mAllocatedInstances != mInstances.size() || mAllocatedInstances == 0;
+    size_t instanceBytes = std::max<size_t>(mInstances.size(), 1) * sizeof(CrowdInstance);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mInstanceBuffer);
+    if (reallocate)
+        glBufferData(GL_SHADER_STORAGE_BUFFER, instanceBytes, mInstances.empty() ? NULL : &mInstances[0], GL_DYNAMIC_DRAW);
+    else
+        statsBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, mInstances.size() * sizeof(CrowdInstance), &mInstances[0]);
+
+    if (reallocate)
+    {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, mVisibleBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, std::max<size_t>(mInstances.size(), 1) * sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, mCommandBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, mCommandTemplate.size() * sizeof(DrawElementsIndirectCommand), &mCommandTemplate[0], GL_DYNAMIC_COPY);
+        mAllocatedInstances = mInstances.size();
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+
+void CrowdRenderer::updateInstances(size_t first, const CrowdInstance* instances, size_t count)
+{
+    if (first + count > mInstanceSlots.size())
+    {
+        std::cerr << "CrowdRenderer: instance update past the " << mInstanceSlots.size() << " instances set" << std::endl;
+        return;
+    }
+
+    // Rows of one mesh land in consecutive slots, so a run of changed rows is usually one span
+    GLuint lowest = ~0u;
+    GLuint highest = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        GLuint slot = mInstanceSlots[first + i];
+        if (slot == ~0u)
+            continue;
+
+        mInstances[slot] = instances[i];
+        lowest = std::min(lowest, slot);
+        highest = std::max(highest, slot);
+    }
+
+    if (!mGpuCulling || lowest > highest)
+        return;
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mInstanceBuffer);
+    statsBufferSubData(GL_SHADER_STORAGE_BUFFER, lowest * sizeof(CrowdInstance), (highest - lowest + 1) * sizeof(CrowdInstance), &mInstances[lowest]);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+
+void CrowdRenderer::render(GLStateCache& stateCache, StreamBuffer& streamBuffer, const mat4& viewProjection)
+{
+    if (mInstances.empty())
+        return;
+
+    if (mGpuCulling)
+        renderGpuCulled(stateCache, viewProjection);
+    else
+        renderCpuCulled(stateCache, streamBuffer, viewProjection);
+}
+
+
+void CrowdRenderer::renderGpuCulled(GLStateCache& stateCache, const mat4& viewProjection)
+{
+    Frustum frustum = extractFrustum(viewProjection);
+
+    // reset the instance counts, 20 bytes per mesh no matter how many instances
+    statsBindBuffer(GL_DRAW_INDIRECT_BUFFER, mCommandBuffer);
+    statsBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, mCommandTemplate.size() * sizeof(DrawElementsIndirectCommand), &mCommandTemplate[0]);
+
+    stateCache.useProgram(mCullProgram);
+    statsUniform4fv(mFrustumPlanesLocation, 6, &frustum.planes[0][0]);
+    statsUniform1ui(mInstanceCountLocation, (GLuint)mInstances.size());
+
+    statsBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, mInstanceBuffer);
+    statsBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, mCommandBuffer);
+    statsBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, mVisibleBuffer);
+
+    statsDispatchCompute((GLuint)(mInstances.size() + 63) / 64, 1, 1);
+
+    // the draw reads the commands, the visible list as an attribute and the instances as storage
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+
+    stateCache.useProgram(mGpuDrawProgram);
+    stateCache.setRenderState(RENDER_STATE_DEFAULT);
+    stateCache.bindVertexArray(mGpuVertexArray);
+    statsMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)0, (GLsizei)mCommandTemplate.size(), 0);
+}
+
+
+void CrowdRenderer::renderCpuCulled(GLStateCache& stateCache, StreamBuffer& streamBuffer, const mat4& viewProjection)
+{
+    Frustum frustum = extractFrustum(viewProjection);
+
+    mLastVisibleCount = 0;
+    for (int mesh = 0; mesh < MESH_COUNT; ++mesh)
+    {
+        GLuint count = mMeshInstanceCount[mesh];
+        if (count == 0)
+            continue;
+
+        // room for all of them, only the visible ones get written
+        StreamAllocation matrices = streamBuffer.allocate(count * sizeof(Affine3x4));
+        if (matrices.data == NULL)
+            continue;
+
+        Affine3x4* visibleMatrices = (Affine3x4*)matrices.data;
+        GLsizei visibleCount = 0;
+        const CrowdInstance* instance = &mInstances[mMeshFirstInstance[mesh]];
+        for (GLuint i = 0; i < count; ++i, ++instance)
+        {
+            if (sphereInFrustum(frustum, vec3(instance->bounds), instance->bounds.w))
+                memcpy(&visibleMatrices[visibleCount++], &instance->worldMatrix, sizeof(Affine3x4));
+        }
+
+        mLastVisibleCount += visibleCount;
+        drawStreamedInstances(stateCache, streamBuffer, (MeshId)mesh, matrices, visibleCount);
+    }
+}
+
+
+void CrowdRenderer::drawStreamedInstances(GLStateCache& stateCache, StreamBuffer& streamBuffer, MeshId mesh,
+                                          const StreamAllocation& worldMatrices, GLsizei count, GLsizei viewCount)
+{
+    if (count == 0 || mCpuDrawProgram == 0 || (viewCount > 1 && mMultiViewProgram == 0))
+        return;
+
+    streamBuffer.flush();
+
+    stateCache.setRenderState(RENDER_STATE_DEFAULT);
+    if (viewCount > 1)
+    {
+        stateCache.useProgram(mMultiViewProgram);
+        stateCache.bindVertexArray(mMultiViewVertexArray);
+        if (mMultiViewDivisor != viewCount)
+        {
+            for (int row = 0; row < 3; ++row)
+                glVertexAttribDivisor(3 + row, viewCount);
+            mMultiViewDivisor = viewCount;
+        }
+    }
+    else
+    {
+        stateCache.useProgram(mCpuDrawProgram);
+        stateCache.bindVertexArray(mCpuVertexArray);
+    }
+
+    statsBindBuffer(GL_ARRAY_BUFFER, streamBuffer.buffer());
+    for (int row = 0; row < 3; ++row)
+        glVertexAttribPointer(3 + row, 4, GL_FLOAT, GL_FALSE, sizeof(Affine3x4), (void*)(worldMatrices.offset + row * sizeof(vec4)));
+
+    const Mesh& source = mMeshes->mesh(mesh);
+    statsDrawElementsInstancedBaseVertex(GL_TRIANGLES, source.indexCount, GL_UNSIGNED_INT,
+        (void*)(source.firstIndex * sizeof(GLuint)), count * viewCount, source.baseVertex);
+}
+
+
+CrowdStreamedList CrowdRenderer::streamList(StreamBuffer& streamBuffer, const CrowdDrawList& list)
+{
+    CrowdStreamedList streamed;
+    size_t first = 0;
+    for (int mesh = 0; mesh < MESH_COUNT; ++mesh)
+    {
+        GLsizei count = list.meshCounts[mesh];
+        streamed.counts[mesh] = 0;
+        streamed.matrices[mesh].data = NULL;
+        if (count == 0)
+            continue;
+
+        streamed.matrices[mesh] = streamBuffer.allocate(count * sizeof(Affine3x4));
+        if (streamed.matrices[mesh].data != NULL)
+        {
+            memcpy(streamed.matrices[mesh].data, &list.worldMatrices[first], count * sizeof(Affine3x4));
+            streamed.counts[mesh] = count;
+        }
+        first += count;
+    }
+    return streamed;
+}
+
+
+void CrowdRenderer::drawStreamedList(GLStateCache& stateCache, StreamBuffer& streamBuffer, const CrowdStreamedList& list, GLsizei viewCount)
+{
+    for (int mesh = 0; mesh < MESH_COUNT; ++mesh)
+    {
+        if (list.counts[mesh] > 0)
+            drawStreamedInstances(stateCache, streamBuffer, (MeshId)mesh, list.matrices[mesh], list.counts[mesh], viewCount);
+    }
+}
+
+
+void CrowdRenderer::drawList(GLStateCache& stateCache, StreamBuffer& streamBuffer, const CrowdDrawList& list)
+{
+    drawStreamedList(stateCache, streamBuffer, streamList(streamBuffer, list));
+}
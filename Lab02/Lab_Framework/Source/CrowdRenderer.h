@@ -0,0 +1,156 @@
+//
+// COMP 371 Labs Framework
+//
+// Instanced crowd rendering with frustum culling -- COMP371 Assignment 2
+//
+// Two paths draw the same instances:
+//  - GPU culling (GL 4.3): instances and their bounds live in a shader storage buffer,
+//    a compute shader tests them against the frustum planes, appends the visible ones
+//    and bumps the instanceCount of a DrawElementsIndirectCommand per mesh, then the
+//    crowd draws with one glMultiDrawElementsIndirect. The CPU work per frame is the
+//    same whatever the instance count.
+//  - CPU culling: instances are tested on the CPU and the visible world matrices are
+//    written to the stream buffer as instance attributes, one instanced draw per mesh.
+
+#pragma once
+
+#define GLEW_STATIC 1
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "Affine.h"
+#include "MeshLibrary.h"
+#include "StreamBuffer.h"
+
+class GLStateCache;
+class ShaderPermutations;
+
+
+// Matches the std430 Instance struct in the crowd shaders, 80 bytes
+struct CrowdInstance
+{
+    Affine3x4 worldMatrix;  // mat3x4 in the shaders
+    glm::vec4 bounds;   // world space bounding sphere, xyz center and w radius
+    GLuint mesh;        // MeshId, has to be a triangle mesh
+    GLuint padding[3];
+};
+
+// Fills in the bounds from the mesh's sphere
+CrowdInstance makeCrowdInstance(const MeshLibrary& meshes, MeshId mesh, const Affine3x4& worldMatrix);
+
+
+// One impostor billboard, 32 bytes of instance attributes for the ImpostorRenderer
+struct CrowdImpostor
+{
+    glm::vec4 bounds;       // world space bounding sphere, the quad covers it
+    float yaw;              // the entity's turn around z, picks the atlas cell with the camera direction
+    float atlasRow;         // impostorAtlasRow() of the entity's mesh
+    float padding[2];
+};
+
+
+// Crowd culled away from the render thread: visible world matrices grouped by mesh
+struct CrowdDrawList
+{
+    std::vector<Affine3x4> worldMatrices;
+    GLsizei meshCounts[MESH_COUNT];     // consecutive ranges of worldMatrices, in MeshId order
+    std::vector<CrowdImpostor> impostors;   // far ones drawn as billboards instead
+};
+
+// A draw list written to the stream buffer, drawable any number of times this frame
+struct CrowdStreamedList
+{
+    StreamAllocation matrices[MESH_COUNT];
+    GLsizei counts[MESH_COUNT];
+};
+
+
+class CrowdRenderer
+{
+public:
+    CrowdRenderer();
+    ~CrowdRenderer();
+
+    // gpuCulling asks for the compute path, it is only used if the context supports it.
+    // Draws with the scene shader's instanced variants.
+    bool create(const MeshLibrary& meshes, ShaderPermutations& sceneShaders, bool gpuCulling);
+    void destroy();
+
+    // Uploads the instances, only needed again when they change. The buffers are only
+    // reallocated when the count differs from the last call.
+    void setInstances(const CrowdInstance* instances, size_t count);
+
+    // Replaces instances [first, first + count) of the last setInstances() and uploads
+    // just the slots they moved to. Their meshes have to stay the same.
+    void updateInstances(size_t first, const CrowdInstance* instances, size_t count);
+
+    // Culls against the view-projection and draws; the camera block must already be bound
+    void render(GLStateCache& stateCache, StreamBuffer& streamBuffer, const glm::mat4& viewProjection);
+
+    // CPU path only: draws count affine world matrices the caller culled and wrote to the stream
+    // buffer itself, without going through the instances given to setInstances. With viewCount
+    // above 1 every instance is drawn once per viewport of the bound viewport array, in one call;
+    // the camera block then has to be the MULTI_VIEW one.
+    void drawStreamedInstances(GLStateCache& stateCache, StreamBuffer& streamBuffer, MeshId mesh,
+                               const StreamAllocation& worldMatrices, GLsizei count, GLsizei viewCount = 1);
+
+    // CPU path only: streams every mesh's range of the list once, then draws it
+    CrowdStreamedList streamList(StreamBuffer& streamBuffer, const CrowdDrawList& list);
+    void drawStreamedList(GLStateCache& stateCache, StreamBuffer& streamBuffer, const CrowdStreamedList& list, GLsizei viewCount = 1);
+    void drawList(GLStateCache& stateCache, StreamBuffer& streamBuffer, const CrowdDrawList& list);
+
+    // drawStreamedInstances can take a viewCount above 1
+    bool supportsMultiView() const { return mMultiViewProgram != 0; }
+
+    bool usesGpuCulling() const { return mGpuCulling; }
+    size_t instanceCount() const { return mInstances.size(); }
+
+    // Visible instances of the last CPU culled frame, the GPU path never reads its count back
+    size_t lastVisibleCount() const { return mLastVisibleCount; }
+
+private:
+    struct DrawElementsIndirectCommand
+    {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint baseVertex;
+        GLuint baseInstance;
+    };
+
+    void renderGpuCulled(GLStateCache& stateCache, const glm::mat4& viewProjection);
+    void renderCpuCulled(GLStateCache& stateCache, StreamBuffer& streamBuffer, const glm::mat4& viewProjection);
+
+    const MeshLibrary* mMeshes;
+    bool mGpuCulling;
+
+    std::vector<CrowdInstance> mInstances;  // sorted by mesh
+    std::vector<GLuint> mInstanceSlots;     // where each instance given to setInstances went, ~0 when skipped
+    size_t mAllocatedInstances;             // what the GPU buffers were last sized for
+    GLuint mMeshFirstInstance[MESH_COUNT];
+    GLuint mMeshInstanceCount[MESH_COUNT];
+    size_t mLastVisibleCount;
+
+    // GPU path
+    GLuint mCullProgram;
+    GLuint mGpuDrawProgram;
+    GLuint mGpuVertexArray;
+    GLuint mInstanceBuffer;
+    GLuint mCommandBuffer;
+    GLuint mVisibleBuffer;
+    GLint mFrustumPlanesLocation;
+    GLint mInstanceCountLocation;
+    std::vector<DrawElementsIndirectCommand> mCommandTemplate; // instanceCount 0, uploaded to reset each frame
+
+    // CPU path
+    GLuint mCpuDrawProgram;
+    GLuint mCpuVertexArray;
+
+    // CPU path over several viewports, the instance divisor is the view count
+    GLuint mMultiViewProgram;
+    GLuint mMultiViewVertexArray;
+    GLsizei mMultiViewDivisor;
+};
@@ -0,0 +1,282 @@
+//
+// COMP 371 Labs Framework
+//
+// Systems driving the snowman crowd -- COMP371 Assignment 2
+
+#include "CrowdSystems.h"
+#include "CrowdRenderer.h"
+#include "MeshLibrary.h"
+#include "Minimap.h"
+
+#include <cfloat>
+#include <cmath>
+
+using namespace glm;
+
+
+ComponentMask crowdComponents()
+{
+    return componentBit<TransformComponent>() | componentBit<WorldBoundsComponent>() | componentBit<RenderableComponent>()
+         | componentBit<VisibilityComponent>() | componentBit<SpawnComponent>();
+}
+
+
+// The transform and instance systems walk the same rows, so their row numbers agree
+static ComponentMask transformedComponents()
+{
+    return componentBit<TransformComponent>() | componentBit<WorldBoundsComponent>() | componentBit<RenderableComponent>();
+}
+
+
+Entity spawnCrowdMember(EntityWorld& world, const vec3& position, float yaw, float scale, bool animated)
+{
+    Entity entity = world.create(crowdComponents() | (animated ? componentBit<AnimationComponent>() : 0));
+
+    TransformComponent* transform = world.get<TransformComponent>(entity);
+    transform->position = position;
+    transform->yaw = yaw;
+    transform->scale = scale;
+    transform->dirty = 1;
+
+    world.get<RenderableComponent>(entity)->mesh = MESH_SNOWMAN;
+
+    SpawnComponent* spawn = world.get<SpawnComponent>(entity);
+    spawn->position = position;
+    spawn->yaw = yaw;
+    spawn->scale = scale;
+
+    if (animated)
+        world.get<AnimationComponent>(entity)->turnSpeed = 1.0f;
+
+    return entity;
+}
+
+
+void resetCrowdSystem(EntityWorld& world)
+{
+    world.query(componentBit<TransformComponent>() | componentBit<SpawnComponent>(), [](Archetype& archetype)
+    {
+        TransformComponent* transforms = archetype.components<TransformComponent>();
+        const SpawnComponent* spawns = archetype.components<SpawnComponent>();
+        for (size_t i = 0; i < archetype.size(); ++i)
+        {
+            transforms[i].position = spawns[i].position;
+            transforms[i].yaw = spawns[i].yaw;
+            transforms[i].scale = spawns[i].scale;
+            transforms[i].dirty = 1;
+        }
+    });
+}
+
+
+void animationSystem(EntityWorld& world, float dt, size_t first, size_t count)
+{
+    world.queryRange(componentBit<TransformComponent>() | componentBit<AnimationComponent>(), first, count,
+        [dt](Archetype& archetype, size_t begin, size_t end)
+    {
+        TransformComponent* transforms = archetype.components<TransformComponent>();
+        const AnimationComponent* animations = archetype.components<AnimationComponent>();
+        for (size_t i = begin; i < end; ++i)
+        {
+            transforms[i].yaw = fmodf(transforms[i].yaw + animations[i].turnSpeed * dt, 6.2831853f);
+            transforms[i].dirty = 1;
+        }
+    });
+}
+
+
+size_t transformSystem(EntityWorld& world, const MeshLibrary& meshes)
+{
+    CrowdRowRange changedRows;
+    return transformSystem(world, meshes, 0, world.entityCount(), changedRows);
+}
+
+
+size_t transformSystem(EntityWorld& world, const MeshLibrary& meshes, size_t first, size_t count, CrowdRowRange& changedRows)
+{
+    size_t changed = 0;
+    changedRows.first = changedRows.end = 0;
+
+    // the calls cover the range's rows one after the other, row counts where each starts
+    size_t row = first;
+    world.queryRange(transformedComponents(), first, count, [&](Archetype& archetype, size_t begin, size_t end)
+    {
+        TransformComponent* transforms = archetype.components<TransformComponent>();
+        WorldBoundsComponent* worldBounds = archetype.components<WorldBoundsComponent>();
+        const RenderableComponent* renderables = archetype.components<RenderableComponent>();
+        for (size_t i = begin; i < end; ++i)
+        {
+            TransformComponent& transform = transforms[i];
+            if (!transform.dirty)
+                continue;
+
+            // translate * rotate around z * uniform scale, written out as affine rows
+            float c = cosf(transform.yaw) * transform.scale;
+            float s = sinf(transform.yaw) * transform.scale;
+            Affine3x4& world = worldBounds[i].worldMatrix;
+            world.rows[0] = vec4(c, -s, 0.0f, transform.position.x);
+            world.rows[1] = vec4(s, c, 0.0f, transform.position.y);
+            world.rows[2] = vec4(0.0f, 0.0f, transform.scale, transform.position.z);
+
+            const Mesh& mesh = meshes.mesh((MeshId)renderables[i].mesh);
+            worldBounds[i].bounds = vec4(transformPoint(world, mesh.boundsCenter), mesh.boundsRadius * transform.scale);
+
+            transform.dirty = 0;
+            changed++;
+
+            size_t changedRow = row + (i - begin);
+            if (changedRows.first == changedRows.end)
+                changedRows.first = changedRow;
+            changedRows.end = changedRow + 1;
+        }
+        row += end - begin;
+    });
+    return changed;
+}
+
+
+size_t cullingSystem(EntityWorld& world, const Frustum& frustum)
+{
+    return cullingSystem(world, frustum, 0, world.entityCount());
+}
+
+
+size_t cullingSystem(EntityWorld& world, const Frustum& frustum, size_t first, size_t count)
+{
+    return cullingSystem(world, &frustum, 1, first, count);
+}
+
+
+size_t cullingSystem(EntityWorld& world, const Frustum* frusta, int frustumCount, size_t first, size_t count)
+{
+    size_t visibleCount = 0;
+    world.queryRange(componentBit<WorldBoundsComponent>() | componentBit<VisibilityComponent>(), first, count,
+        [&](Archetype& archetype, size_t begin, size_t end)
+    {
+        const WorldBoundsComponent* worldBounds = archetype.components<WorldBoundsComponent>();
+        VisibilityComponent* visibility = archetype.components<VisibilityComponent>();
+        for (size_t i = begin; i < end; ++i)
+        {
+            const vec4& bounds = worldBounds[i].bounds;
+            int visible = 0;
+            for (int f = 0; f < frustumCount && !visible; ++f)
+                visible = sphereInFrustum(frusta[f], vec3(bounds), bounds.w) ? 1 : 0;
+            visibility[i].visible = visible;
+            visibleCount += visibility[i].visible;
+        }
+    });
+    return visibleCount;
+}
+
+
+void crowdInstanceSystem(EntityWorld& world, const CrowdRowRange& rows, std::vector<CrowdInstance>& instances)
+{
+    instances.clear();
+    world.queryRange(transformedComponents(), rows.first, rows.end - rows.first, [&](Archetype& archetype, size_t begin, size_t end)
+    {
+        const WorldBoundsComponent* worldBounds = archetype.components<WorldBoundsComponent>();
+        const RenderableComponent* renderables = archetype.components<RenderableComponent>();
+        for (size_t i = begin; i < end; ++i)
+        {
+            CrowdInstance instance;
+            instance.worldMatrix = worldBounds[i].worldMatrix;
+            instance.bounds = worldBounds[i].bounds;
+            instance.mesh = renderables[i].mesh;
+            instance.padding[0] = instance.padding[1] = instance.padding[2] = 0;
+            instances.push_back(instance);
+        }
+    });
+}
+
+
+void visibleCrowdSystem(EntityWorld& world, CrowdDrawList& drawList, const vec3* cameraPositions, int cameraCount,
+                        float impostorDistance)
+{
+    const ComponentMask required = componentBit<TransformComponent>() | componentBit<WorldBoundsComponent>()
+                                 | componentBit<RenderableComponent>() | componentBit<VisibilityComponent>();
+
+    // far entities whose mesh has an impostor become billboards instead of mesh instances,
+    // one close to any view stays a mesh in all of them
+    const float impostorDistanceSquared = impostorDistance > 0.0f ? impostorDistance * impostorDistance : FLT_MAX;
+    auto isImpostor = [&](const vec4& bounds, unsigned int mesh)
+    {
+        if (impostorAtlasRow((MeshId)mesh) < 0)
+            return false;
+        for (int camera = 0; camera < cameraCount; ++camera)
+        {
+            vec3 offset = vec3(bounds) - cameraPositions[camera];
+            if (dot(offset, offset) <= impostorDistanceSquared)
+                return false;
+        }
+        return true;
+    };
+
+    // count first so every mesh gets one contiguous range of the list
+    for (int mesh = 0; mesh < MESH_COUNT; ++mesh)
+        drawList.meshCounts[mesh] = 0;
+    world.query(required, [&](Archetype& archetype)
+    {
+        const WorldBoundsComponent* worldBounds = archetype.components<WorldBoundsComponent>();
+        const RenderableComponent* renderables = archetype.components<RenderableComponent>();
+        const VisibilityComponent* visibility = archetype.components<VisibilityComponent>();
+        for (size_t i = 0; i < archetype.size(); ++i)
+        {
+            if (visibility[i].visible && !isImpostor(worldBounds[i].bounds, renderables[i].mesh))
+                drawList.meshCounts[renderables[i].mesh]++;
+        }
+    });
+
+    size_t written[MESH_COUNT];
+    size_t total = 0;
+    for (int mesh = 0; mesh < MESH_COUNT; ++mesh)
+    {
+        written[mesh] = total;
+        total += drawList.meshCounts[mesh];
+    }
+    drawList.worldMatrices.resize(total);
+    drawList.impostors.clear();
+
+    Affine3x4* matrices = total > 0 ? &drawList.worldMatrices[0] : NULL;
+    world.query(required, [&](Archetype& archetype)
+    {
+        const TransformComponent* transforms = archetype.components<TransformComponent>();
+        const WorldBoundsComponent* worldBounds = archetype.components<WorldBoundsComponent>();
+        const RenderableComponent* renderables = archetype.components<RenderableComponent>();
+        const VisibilityComponent* visibility = archetype.components<VisibilityComponent>();
+        for (size_t i = 0; i < archetype.size(); ++i)
+        {
+            if (!visibility[i].visible)
+                continue;
+
+            if (isImpostor(worldBounds[i].bounds, renderables[i].mesh))
+            {
+                CrowdImpostor impostor;
+                impostor.bounds = worldBounds[i].bounds;
+                impostor.yaw = transforms[i].yaw;
+                impostor.atlasRow = (float)impostorAtlasRow((MeshId)renderables[i].mesh);
+                impostor.padding[0] = impostor.padding[1] = 0.0f;
+                drawList.impostors.push_back(impostor);
+            }
+            else
+            {
+                matrices[written[renderables[i].mesh]++] = worldBounds[i].worldMatrix;
+            }
+        }
+    });
+}
+
+
+void minimapMarkerSystem(EntityWorld& world, const vec3& color, std::vector<MinimapMarker>& markers)
+{
+    world.query(componentBit<WorldBoundsComponent>(), [&](Archetype& archetype)
+    {
+        const WorldBoundsComponent* worldBounds = archetype.components<WorldBoundsComponent>();
+        for (size_t i = 0; i < archetype.size(); ++i)
+        {
+            MinimapMarker marker;
+            marker.position = vec3(worldBounds[i].bounds);
+            marker.color = color;
+            markers.push_back(marker);
+        }
+    });
+}
@@ -0,0 +1,69 @@
+//
+// COMP 371 Labs Framework
+//
+// Systems driving the snowman crowd -- COMP371 Assignment 2
+//
+// Each system is one query over the entity world and only reads and writes the
+// component arrays it needs. Run them in the order declared here every frame; the
+// last two only gather what the render thread draws, they never touch GL. The
+// per-entity systems also come in a version over a row range of their query, so a
+// frame task can split them into chunks; chunks of one system never share a row.
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "EntityWorld.h"
+#include "Frustum.h"
+
+#include <vector>
+
+class MeshLibrary;
+struct CrowdDrawList;
+struct CrowdInstance;
+struct MinimapMarker;
+
+
+// Components every crowd member has; some also get an AnimationComponent
+ComponentMask crowdComponents();
+
+// Rows [first, end) of the transform system's query, in the order the range versions count them
+struct CrowdRowRange
+{
+    size_t first;
+    size_t end;     // first == end when empty
+};
+
+// Adds a snowman standing at position, remembering it as its spawn point
+Entity spawnCrowdMember(EntityWorld& world, const glm::vec3& position, float yaw, float scale, bool animated);
+
+// Puts everyone back where they spawned
+void resetCrowdSystem(EntityWorld& world);
+
+// Turns the animated entities, flags their transforms dirty
+void animationSystem(EntityWorld& world, float dt, size_t first, size_t count);
+
+// Rebuilds world matrix and bounds of dirty transforms, returns how many changed.
+// The range version also gives the span of rows that changed.
+size_t transformSystem(EntityWorld& world, const MeshLibrary& meshes);
+size_t transformSystem(EntityWorld& world, const MeshLibrary& meshes, size_t first, size_t count, CrowdRowRange& changedRows);
+
+// Flags the entities whose bounds touch the frustum, returns how many are visible
+size_t cullingSystem(EntityWorld& world, const Frustum& frustum);
+size_t cullingSystem(EntityWorld& world, const Frustum& frustum, size_t first, size_t count);
+
+// Several viewports sharing one visible list: an entity is visible when it is inside any of the frusta
+size_t cullingSystem(EntityWorld& world, const Frustum* frusta, int frustumCount, size_t first, size_t count);
+
+// GPU culling: the rows of the range as instances for the renderer to upload, run over
+// the rows whose transforms changed. Instance i of the renderer is row i.
+void crowdInstanceSystem(EntityWorld& world, const CrowdRowRange& rows, std::vector<CrowdInstance>& instances);
+
+// CPU culling: the world matrices of the entities flagged visible, grouped by mesh.
+// Visible entities farther than impostorDistance from every view's camera go to the
+// draw list's impostors when their mesh has one; 0 turns impostors off
+void visibleCrowdSystem(EntityWorld& world, CrowdDrawList& drawList, const glm::vec3* cameraPositions, int cameraCount,
+                        float impostorDistance);
+
+// Minimap: appends a marker at every entity's position, run at the minimap's update rate
+void minimapMarkerSystem(EntityWorld& world, const glm::vec3& color, std::vector<MinimapMarker>& markers);
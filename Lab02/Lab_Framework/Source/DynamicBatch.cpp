@@ -0,0 +1,182 @@
+//
+// COMP 371 Labs Framework
+//
+// Dynamic batching -- COMP371 Assignment 2
+
+#include "DynamicBatch.h"
+#include "GLStats.h"
+#include "RenderQueue.h"
+
+#include <cstring>
+
+using namespace glm;
+
+
+// destination[i] is source[indices[i]] with its position taken to world space
+static void transformVertices(const Affine3x4& world, const MeshVertex* source, const GLuint* indices, GLsizei count, MeshVertex* destination)
+{
+#if LIGMA_AFFINE_SSE
+    // The rows transposed into columns stay in registers: each position is then three
+    // broadcast multiply-adds on top of the translation
+    __m128 c0 = _mm_loadu_ps(&world.rows[0].x);
+    __m128 c1 = _mm_loadu_ps(&world.rows[1].x);
+    __m128 c2 = _mm_loadu_ps(&world.rows[2].x);
+    __m128 c3 = _mm_setzero_ps();
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+
+    for (GLsizei i = 0; i < count; ++i)
+    {
+        const MeshVertex& vertex = source[indices[i]];
+        __m128 position = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(vertex.position.x)),
+                                                _mm_mul_ps(c1, _mm_set1_ps(vertex.position.y))),
+                                     _mm_add_ps(_mm_mul_ps(c2, _mm_set1_ps(vertex.position.z)), c3));
+
+        // the fourth lane lands on the color's first component, written right after
+        _mm_storeu_ps(&destination[i].position.x, position);
+        memcpy(&destination[i].color, &vertex.color, sizeof(vec3));
+    }
+#else
+    for (GLsizei i = 0; i < count; ++i)
+    {
+        const MeshVertex& vertex = source[indices[i]];
+        destination[i].position = transformPoint(world, vertex.position);
+        destination[i].color = vertex.color;
+    }
+#endif
+}
+
+
+DynamicBatch::DynamicBatch()
+    : mMeshes(NULL), mProgram(0), mModelViewProjectionLocation(-1), mVertexArray(0), mMaxVertices(0)
+{
+    memset(&mVertices, 0, sizeof(mVertices));
+}
+
+
+DynamicBatch::~DynamicBatch()
+{
+    destroy();
+}
+
+
+void DynamicBatch::create(const MeshLibrary& meshes, GLuint program, GLint modelViewProjectionLocation, GLuint streamBufferObject, GLsizei maxVertices)
+{
+    destroy();
+    mMeshes = &meshes;
+    mProgram = program;
+    mModelViewProjectionLocation = modelViewProjectionLocation;
+    mMaxVertices = maxVertices;
+
+    // Vertices move with each allocation, the attribute offsets are set when drawing
+    glGenVertexArrays(1, &mVertexArray);
+    glBindVertexArray(mVertexArray);
+    glBindBuffer(GL_ARRAY_BUFFER, streamBufferObject);
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glBindVertexArray(0);
+
+    // A frame's worth of parts stays off the heap after the first frames
+    mEntries.reserve(16);
+    mGroups.reserve(8);
+}
+
+
+void DynamicBatch::destroy()
+{
+    if (mVertexArray != 0)
+        glDeleteVertexArrays(1, &mVertexArray);
+    mVertexArray = 0;
+    mMeshes = NULL;
+    clear();
+}
+
+
+void DynamicBatch::clear()
+{
+    mEntries.clear();
+    mGroups.clear();
+    memset(&mVertices, 0, sizeof(mVertices));
+}
+
+
+bool DynamicBatch::add(MeshId meshId, const Affine3x4& worldMatrix, GLenum mode, unsigned int material, unsigned int renderState)
+{
+    // upload() writes one vertex per index, that is what the limit weighs
+    if (mMeshes == NULL || mMeshes->mesh(meshId).indexCount > mMaxVertices)
+        return false;
+
+    size_t group = 0;
+    while (group < mGroups.size()
+           && (mGroups[group].material != material || mGroups[group].mode != mode || mGroups[group].renderState != renderState))
+        ++group;
+
+    if (group == mGroups.size())
+    {
+        Group newGroup = { material, mode, renderState, 0, 0 };
+        mGroups.push_back(newGroup);
+    }
+    mGroups[group].count += mMeshes->mesh(meshId).indexCount;
+
+    Entry entry = { meshId, group, worldMatrix };
+    mEntries.push_back(entry);
+    return true;
+}
+
+
+bool DynamicBatch::upload(StreamBuffer& streamBuffer)
+{
+    if (mEntries.empty())
+        return true;
+
+    // Groups are consecutive in the upload, so each is a single vertex range
+    GLsizei vertexCount = 0;
+    for (size_t group = 0; group < mGroups.size(); ++group)
+    {
+        mGroups[group].first = vertexCount;
+        vertexCount += mGroups[group].count;
+    }
+
+    mVertices = streamBuffer.allocate(vertexCount * sizeof(MeshVertex));
+    if (mVertices.data == NULL)
+        return false;
+
+    // count goes back up as each group's meshes are written
+    for (size_t group = 0; group < mGroups.size(); ++group)
+        mGroups[group].count = 0;
+
+    MeshVertex* vertices = (MeshVertex*)mVertices.data;
+    for (size_t i = 0; i < mEntries.size(); ++i)
+    {
+        const Entry& entry = mEntries[i];
+        const Mesh& mesh = mMeshes->mesh(entry.mesh);
+        Group& group = mGroups[entry.group];
+
+        transformVertices(entry.worldMatrix, &mMeshes->vertices()[mesh.baseVertex], &mMeshes->indices()[mesh.firstIndex], mesh.indexCount,
+                          vertices + group.first + group.count);
+        group.count += mesh.indexCount;
+    }
+
+    streamBuffer.flush();
+    return true;
+}
+
+
+void DynamicBatch::render(GLStateCache& stateCache, StreamBuffer& streamBuffer, const mat4& viewProjection)
+{
+    if (mVertices.data == NULL)
+        return;
+
+    // Already in world space, the shader only needs the view-projection
+    stateCache.useProgram(mProgram);
+    stateCache.uniformMatrix4(mModelViewProjectionLocation, viewProjection);
+    stateCache.bindVertexArray(mVertexArray);
+    statsBindBuffer(GL_ARRAY_BUFFER, streamBuffer.buffer());
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void*)mVertices.offset);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void*)(mVertices.offset + sizeof(vec3)));
+
+    for (size_t group = 0; group < mGroups.size(); ++group)
+    {
+        stateCache.setRenderState(mGroups[group].renderState);
+        statsDrawArrays(mGroups[group].mode, mGroups[group].first, mGroups[group].count);
+    }
+}
@@ -0,0 +1,86 @@
+//
+// COMP 371 Labs Framework
+//
+// Dynamic batching -- COMP371 Assignment 2
+//
+// Small meshes that move every frame (olaf's four parts) cost a draw and a matrix
+// upload each, and parts with different meshes cannot share an instanced draw. A
+// dynamic batch transforms their vertices into world space on the CPU instead,
+// straight into the stream buffer, and draws everything that shares a material,
+// primitive mode and render state with one glDrawArrays. Transforming is only
+// cheaper than a draw for small meshes, so add() turns down any mesh that would
+// write more than the batch's vertex limit, one per index since the copies are
+// de-indexed, and the caller draws that one on its own. Olaf's parts are 36
+// vertices each, so the default limit batches all of them; a limit under 36 sends
+// every part back to the render queue.
+
+#pragma once
+
+#define GLEW_STATIC 1
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "Affine.h"
+#include "MeshLibrary.h"
+#include "StreamBuffer.h"
+
+class GLStateCache;
+
+
+class DynamicBatch
+{
+public:
+    static const GLsizei DefaultMaxVertices = 300;
+
+    DynamicBatch();
+    ~DynamicBatch();
+
+    // Draws with program, which takes the view-projection in modelViewProjectionLocation.
+    // Meshes with more than maxVertices indices are left to the caller, 0 batches nothing.
+    void create(const MeshLibrary& meshes, GLuint program, GLint modelViewProjectionLocation, GLuint streamBufferObject, GLsizei maxVertices);
+    void destroy();
+
+    void clear();
+
+    // False when the mesh is too big to batch, nothing is recorded then
+    bool add(MeshId mesh, const Affine3x4& worldMatrix, GLenum mode, unsigned int material, unsigned int renderState);
+
+    // Transforms every mesh added since clear() into this frame's stream buffer, once
+    // per frame before the first render()
+    bool upload(StreamBuffer& streamBuffer);
+
+    // One draw per material, mode and render state, in the order they were first added
+    void render(GLStateCache& stateCache, StreamBuffer& streamBuffer, const glm::mat4& viewProjection);
+
+    size_t size() const { return mEntries.size(); }
+
+private:
+    struct Entry
+    {
+        MeshId mesh;
+        size_t group;
+        Affine3x4 worldMatrix;
+    };
+
+    struct Group
+    {
+        unsigned int material;
+        GLenum mode;
+        unsigned int renderState;
+        GLint first;            // vertex in the upload
+        GLsizei count;
+    };
+
+    const MeshLibrary* mMeshes;
+    GLuint mProgram;
+    GLint mModelViewProjectionLocation;
+    GLuint mVertexArray;
+    GLsizei mMaxVertices;
+
+    std::vector<Entry> mEntries;
+    std::vector<Group> mGroups;
+    StreamAllocation mVertices;
+};
@@ -0,0 +1,180 @@
+//
+// COMP 371 Labs Framework
+//
+// Entity-component storage by archetype -- COMP371 Assignment 2
+
+#include "EntityWorld.h"
+
+#include <cassert>
+#include <cstring>
+
+
+EntityWorld::EntityWorld()
+    : mEntityCount(0)
+{
+}
+
+
+unsigned int EntityWorld::findOrCreateArchetype(ComponentMask components)
+{
+    // a handful of archetypes, a linear search is fine
+    for (size_t i = 0; i < mArchetypes.size(); ++i)
+    {
+        if (mArchetypes[i].mMask == components)
+            return (unsigned int)i;
+    }
+
+    mArchetypes.push_back(Archetype(components));
+    return (unsigned int)(mArchetypes.size() - 1);
+}
+
+
+unsigned int EntityWorld::appendRow(unsigned int archetypeIndex, Entity entity)
+{
+    Archetype& archetype = mArchetypes[archetypeIndex];
+    unsigned int row = (unsigned int)archetype.mEntities.size();
+    archetype.mEntities.push_back(entity);
+
+    for (int type = 0; type < COMPONENT_TYPE_COUNT; ++type)
+    {
+        if (archetype.mMask & componentBit((ComponentType)type))
+            archetype.mColumns[type].resize(archetype.mColumns[type].size() + componentSize((ComponentType)type), 0);
+    }
+    return row;
+}
+
+
+void EntityWorld::removeRow(unsigned int archetypeIndex, unsigned int row)
+{
+    Archetype& archetype = mArchetypes[archetypeIndex];
+    unsigned int last = (unsigned int)archetype.mEntities.size() - 1;
+
+    // the last row fills the hole, its slot has to follow it
+    if (row != last)
+    {
+        Entity moved = archetype.mEntities[last];
+        archetype.mEntities[row] = moved;
+        mSlots[moved.index].row = row;
+    }
+    archetype.mEntities.pop_back();
+
+    for (int type = 0; type < COMPONENT_TYPE_COUNT; ++type)
+    {
+        std::vector<unsigned char>& column = archetype.mColumns[type];
+        if (column.empty())
+            continue;
+
+        size_t size = componentSize((ComponentType)type);
+        if (row != last)
+            memcpy(&column[row * size], &column[last * size], size);
+        column.resize(last * size);
+    }
+}
+
+
+Entity EntityWorld::create(ComponentMask components)
+{
+    unsigned int index;
+    if (!mFreeSlots.empty())
+    {
+        index = mFreeSlots.back();
+        mFreeSlots.pop_back();
+    }
+    else
+    {
+        index = (unsigned int)mSlots.size();
+        Slot slot = { 1, 0, 0 };
+        mSlots.push_back(slot);
+    }
+
+    Entity entity = { index, mSlots[index].generation };
+    Slot& slot = mSlots[index];
+    slot.archetype = findOrCreateArchetype(components);
+    slot.row = appendRow(slot.archetype, entity);
+    mEntityCount++;
+    return entity;
+}
+
+
+void EntityWorld::destroy(Entity entity)
+{
+    if (!isAlive(entity))
+        return;
+
+    Slot& slot = mSlots[entity.index];
+    removeRow(slot.archetype, slot.row);
+
+    // old handles to this slot stop matching
+    slot.generation++;
+    mFreeSlots.push_back(entity.index);
+    mEntityCount--;
+}
+
+
+bool EntityWorld::isAlive(Entity entity) const
+{
+    return entity.index < mSlots.size() && mSlots[entity.index].generation == entity.generation;
+}
+
+
+void EntityWorld::clear()
+{
+    mArchetypes.clear();
+    mFreeSlots.clear();
+    for (size_t i = 0; i < mSlots.size(); ++i)
+    {
+        mSlots[i].generation++;
+        mFreeSlots.push_back((unsigned int)i);
+    }
+    mEntityCount = 0;
+}
+
+
+void EntityWorld::setComponents(Entity entity, ComponentMask components)
+{
+    if (!isAlive(entity))
+        return;
+
+    Slot& slot = mSlots[entity.index];
+    unsigned int from = slot.archetype;
+    if (mArchetypes[from].mMask == components)
+        return;
+
+    unsigned int to = findOrCreateArchetype(components);
+    unsigned int fromRow = slot.row;
+    unsigned int toRow = appendRow(to, entity);
+
+    // copy over what both archetypes have, the rest stays zeroed
+    Archetype& source = mArchetypes[from];
+    Archetype& target = mArchetypes[to];
+    for (int type = 0; type < COMPONENT_TYPE_COUNT; ++type)
+    {
+        if (source.mColumns[type].empty() || target.mColumns[type].empty())
+            continue;
+        size_t size = componentSize((ComponentType)type);
+        memcpy(&target.mColumns[type][toRow * size], &source.mColumns[type][fromRow * size], size);
+    }
+
+    removeRow(from, fromRow);
+    slot.archetype = to;
+    slot.row = toRow;
+}
+
+
+ComponentMask EntityWorld::components(Entity entity) const
+{
+    assert(isAlive(entity));
+    return mArchetypes[mSlots[entity.index].archetype].mMask;
+}
+
+
+void EntityWorld::reserve(ComponentMask components, size_t count)
+{
+    Archetype& archetype = mArchetypes[findOrCreateArchetype(components)];
+    archetype.mEntities.reserve(count);
+    for (int type = 0; type < COMPONENT_TYPE_COUNT; ++type)
+    {
+        if (components & componentBit((ComponentType)type))
+            archetype.mColumns[type].reserve(count * componentSize((ComponentType)type));
+    }
+}
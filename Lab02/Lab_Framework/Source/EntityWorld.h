@@ -0,0 +1,139 @@
+//
+// COMP 371 Labs Framework
+//
+// Entity-component storage by archetype -- COMP371 Assignment 2
+//
+// Entities with the same set of components share an archetype, which keeps one
+// contiguous array per component plus the entity handle of every row. Queries
+// walk the archetypes whose mask contains the requested components and hand out
+// the raw arrays, so a system over 100,000 entities is a few tight loops.
+// Removing an entity moves the archetype's last row into the hole; handles stay
+// valid because they go through a slot table with a generation counter.
+
+#pragma once
+
+#include "Components.h"
+
+#include <vector>
+
+
+struct Entity
+{
+    unsigned int index;
+    unsigned int generation;
+};
+
+static const Entity ENTITY_NONE = { 0xFFFFFFFFu, 0 };
+
+inline bool operator==(const Entity& a, const Entity& b) { return a.index == b.index && a.generation == b.generation; }
+inline bool operator!=(const Entity& a, const Entity& b) { return !(a == b); }
+
+
+class Archetype
+{
+public:
+    explicit Archetype(ComponentMask mask) : mMask(mask) {}
+
+    ComponentMask mask() const { return mMask; }
+    bool has(ComponentMask components) const { return (mMask & components) == components; }
+
+    size_t size() const { return mEntities.size(); }
+    const Entity* entities() const { return mEntities.empty() ? NULL : &mEntities[0]; }
+
+    // NULL when the archetype does not have T
+    template <typename T> T* components()
+    {
+        std::vector<unsigned char>& column = mColumns[ComponentTraits<T>::Type];
+        return column.empty() ? NULL : (T*)&column[0];
+    }
+
+private:
+    friend class EntityWorld;
+
+    ComponentMask mMask;
+    std::vector<Entity> mEntities;
+    std::vector<unsigned char> mColumns[COMPONENT_TYPE_COUNT]; // empty for components not in the mask
+};
+
+
+class EntityWorld
+{
+public:
+    EntityWorld();
+
+    // New components start zeroed
+    Entity create(ComponentMask components);
+    void destroy(Entity entity);
+    bool isAlive(Entity entity) const;
+    void clear();
+
+    // Moves the entity to the archetype with the new component set, the handle stays the same
+    void setComponents(Entity entity, ComponentMask components);
+    ComponentMask components(Entity entity) const;
+
+    // Preallocates room for count entities with this component set
+    void reserve(ComponentMask components, size_t count);
+
+    // NULL if the entity is dead or does not have T. The pointer is only good
+    // until the next create, destroy or setComponents.
+    template <typename T> T* get(Entity entity)
+    {
+        if (!isAlive(entity))
+            return NULL;
+        const Slot& slot = mSlots[entity.index];
+        T* column = mArchetypes[slot.archetype].components<T>();
+        return column == NULL ? NULL : column + slot.row;
+    }
+
+    // Calls function(Archetype&) for every non empty archetype that has all the required components
+    template <typename Function> void query(ComponentMask required, Function function)
+    {
+        for (size_t i = 0; i < mArchetypes.size(); ++i)
+        {
+            if (mArchetypes[i].has(required) && mArchetypes[i].size() > 0)
+                function(mArchetypes[i]);
+        }
+    }
+
+    // Like query(), but only over rows [first, first + count) of the matching archetypes
+    // taken one after the other, calling function(Archetype&, begin, end) with the rows
+    // of each archetype that fall inside. Lets a system be split into chunks over threads;
+    // chunks past the last row get no calls.
+    template <typename Function> void queryRange(ComponentMask required, size_t first, size_t count, Function function)
+    {
+        size_t end = first + count;
+        size_t skipped = 0;
+        for (size_t i = 0; i < mArchetypes.size() && skipped < end; ++i)
+        {
+            if (!mArchetypes[i].has(required) || mArchetypes[i].size() == 0)
+                continue;
+
+            size_t size = mArchetypes[i].size();
+            size_t begin = first > skipped ? first - skipped : 0;
+            size_t stop = end - skipped < size ? end - skipped : size;
+            if (begin < stop)
+                function(mArchetypes[i], begin, stop);
+            skipped += size;
+        }
+    }
+
+    size_t entityCount() const { return mEntityCount; }
+    size_t archetypeCount() const { return mArchetypes.size(); }
+
+private:
+    struct Slot
+    {
+        unsigned int generation;
+        unsigned int archetype;
+        unsigned int row;
+    };
+
+    unsigned int findOrCreateArchetype(ComponentMask components);
+    unsigned int appendRow(unsigned int archetype, Entity entity);
+    void removeRow(unsigned int archetype, unsigned int row);
+
+    std::vector<Archetype> mArchetypes;
+    std::vector<Slot> mSlots;
+    std::vector<unsigned int> mFreeSlots;
+    size_t mEntityCount;
+};
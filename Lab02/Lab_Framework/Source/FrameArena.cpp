@@ -0,0 +1,86 @@
+//
+// COMP 371 Labs Framework
+//
+// Per-frame linear allocator -- COMP371 Assignment 2
+
+#include "FrameArena.h"
+
+#include <cstdint>
+#include <cstdlib>
+
+
+FrameArena::FrameArena()
+    : mBlock(NULL), mCapacity(0), mHead(0), mHighWater(0), mOverflowBytes(0)
+{
+}
+
+
+FrameArena::~FrameArena()
+{
+    reset();
+    free(mBlock);
+}
+
+
+void FrameArena::reserve(size_t capacity)
+{
+    if (capacity <= mCapacity)
+        return;
+
+    // only safe between frames, nothing may point into the old block
+    reset();
+    free(mBlock);
+    mBlock = (unsigned char*)malloc(capacity);
+    mCapacity = mBlock != NULL ? capacity : 0;
+}
+
+
+void* FrameArena::allocate(size_t size, size_t alignment)
+{
+    if (mBlock == NULL)
+        reserve(DefaultCapacity);
+
+    size_t start = (mHead + alignment - 1) & ~(alignment - 1);
+    if (start + size <= mCapacity)
+    {
+        mHead = start + size;
+        return mBlock + start;
+    }
+
+    // over budget for this frame: a heap block of its own, the next reset grows the arena
+    void* block = malloc(size + alignment);
+    if (block == NULL)
+        return NULL;
+    mOverflowBlocks.push_back(block);
+    mOverflowBytes += size + alignment;
+
+    uintptr_t address = ((uintptr_t)block + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    return (void*)address;
+}
+
+
+void FrameArena::reset()
+{
+    size_t frameUsed = used();
+    if (frameUsed > mHighWater)
+        mHighWater = frameUsed;
+
+    for (size_t i = 0; i < mOverflowBlocks.size(); ++i)
+        free(mOverflowBlocks[i]);
+    mOverflowBlocks.clear();
+
+    bool overflowed = mOverflowBytes > 0;
+    mHead = 0;
+    mOverflowBytes = 0;
+
+    // half again over the largest frame, so slowly growing frames do not overflow every time
+    if (overflowed)
+        reserve(mHighWater + mHighWater / 2);
+}
+
+
+FrameArena& frameArena()
+{
+    static thread_local FrameArena arena;
+    return arena;
+}
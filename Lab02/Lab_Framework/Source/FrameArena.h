@@ -0,0 +1,60 @@
+//
+// COMP 371 Labs Framework
+//
+// Per-frame linear allocator -- COMP371 Assignment 2
+//
+// Temporary render and simulation data (sort scratch, matrix batches, instance
+// lists) is bumped out of one block and all of it is released at once by reset()
+// at the end of the frame. Every thread has its own arena, so allocating never
+// locks. A frame that does not fit gets heap blocks for the overflow and the block
+// grows at the next reset, so after the first few frames nothing hits the heap.
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+
+class FrameArena
+{
+public:
+    static const size_t DefaultCapacity = 1 << 20;
+
+    FrameArena();
+    ~FrameArena();
+
+    // Sizes the block, only grows it. Call before the first frame to skip the warm-up growth.
+    void reserve(size_t capacity);
+
+    // alignment has to be a power of two
+    void* allocate(size_t size, size_t alignment = 16);
+
+    template <typename T> T* allocateArray(size_t count)
+    {
+        return (T*)allocate(count * sizeof(T), alignof(T) > 16 ? alignof(T) : 16);
+    }
+
+    // Releases everything allocated since the last reset, grows the block if this frame overflowed
+    void reset();
+
+    size_t used() const { return mHead + mOverflowBytes; }
+    size_t capacity() const { return mCapacity; }
+    size_t highWater() const { return mHighWater; }     // most used by any frame so far
+
+private:
+    FrameArena(const FrameArena&);
+    FrameArena& operator=(const FrameArena&);
+
+    unsigned char* mBlock;
+    size_t mCapacity;
+    size_t mHead;
+    size_t mHighWater;
+    size_t mOverflowBytes;
+    std::vector<void*> mOverflowBlocks;
+};
+
+
+// The calling thread's arena. The render thread resets it after each frame, the main
+// thread at the end of its loop and each job worker before its first job of a frame.
+FrameArena& frameArena();
+
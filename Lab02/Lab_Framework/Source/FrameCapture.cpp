@@ -0,0 +1,191 @@
+//
+// COMP 371 Labs Framework
+//
+// Asynchronous frame capture -- COMP371 Assignment 2
+
+#include "FrameCapture.h"
+#include "Image.h"
+#include "AllocationTracker.h"
+
+#include <cstdio>
+#include <iostream>
+
+
+FrameCapture::FrameCapture()
+    : mFramesCaptured(0), mTolerance(0), mMaxDifferentFraction(0.0), mStopping(false), mGoldenMismatches(0)
+{
+}
+
+
+FrameCapture::~FrameCapture()
+{
+    destroy();
+}
+
+
+bool FrameCapture::create(const char* directory, const char* goldenDirectory, int tolerance, double maxDifferentFraction)
+{
+    destroy();
+
+    mDirectory = directory;
+    mGoldenDirectory = goldenDirectory != NULL ? goldenDirectory : "";
+    mTolerance = tolerance;
+    mMaxDifferentFraction = maxDifferentFraction;
+    mFramesCaptured = 0;
+    mStopping = false;
+    mGoldenMismatches = 0;
+
+    mReadback.create();
+    mWriter = std::thread(&FrameCapture::writerLoop, this);
+    return true;
+}
+
+
+unsigned int FrameCapture::destroy()
+{
+    if (!mWriter.joinable())
+        return 0;
+
+    mReadback.flush([this](const unsigned char* rgba, unsigned int frameNumber, int width, int height)
+    {
+        queueFrame(rgba, frameNumber, width, height);
+    });
+    mReadback.destroy();
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mWorkAvailable.notify_one();
+    mWriter.join();
+
+    return mGoldenMismatches;
+}
+
+
+void FrameCapture::endFrame(unsigned int frameNumber, bool capture, int width, int height)
+{
+    // Lag frames later these are already done, waiting is only a safety net
+    auto consume = [this](const unsigned char* rgba, unsigned int readFrame, int readWidth, int readHeight)
+    {
+        queueFrame(rgba, readFrame, readWidth, readHeight);
+    };
+    mReadback.collect(frameNumber, true, consume);
+
+    if (!capture)
+        return;
+
+    // every buffer is collected by now unless the ring is shorter than the lag
+    if (!mReadback.read(frameNumber, width, height))
+    {
+        mReadback.flush(consume);
+        if (!mReadback.read(frameNumber, width, height))
+            return;
+    }
+    mFramesCaptured++;
+}
+
+
+void FrameCapture::queueFrame(const unsigned char* rgba, unsigned int frameNumber, int width, int height)
+{
+    WriteJob job;
+    job.frameNumber = frameNumber;
+    job.width = width;
+    job.height = height;
+
+    // a buffer the writer is done with keeps its capacity, so steady capturing does not allocate
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (!mSpareBuffers.empty())
+        {
+            job.rgba.swap(mSpareBuffers.back());
+            mSpareBuffers.pop_back();
+        }
+    }
+    job.rgba.assign(rgba, rgba + (size_t)width * height * 4);
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mJobs.push_back(std::move(job));
+    }
+    mWorkAvailable.notify_one();
+}
+
+
+void FrameCapture::writerLoop()
+{
+    AllocationTracker::setThreadName("frame capture writer");
+
+    std::vector<WriteJob> jobs;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mWorkAvailable.wait(lock, [this] { return mStopping || !mJobs.empty(); });
+            if (mJobs.empty())
+                return;
+
+            // take everything queued, the render thread gets the emptied vector back
+            jobs.swap(mJobs);
+        }
+
+        for (size_t i = 0; i < jobs.size(); ++i)
+            writeFrame(jobs[i]);
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            for (size_t i = 0; i < jobs.size(); ++i)
+                mSpareBuffers.push_back(std::move(jobs[i].rgba));
+        }
+        jobs.clear();
+    }
+}
+
+
+void FrameCapture::writeFrame(WriteJob& job)
+{
+    // GL rows start at the bottom, PPM rows at the top; alpha is dropped
+    Image image;
+    image.width = job.width;
+    image.height = job.height;
+    image.rgb.resize((size_t)job.width * job.height * 3);
+    for (int y = 0; y < job.height; ++y)
+    {
+        const unsigned char* source = &job.rgba[(size_t)(job.height - 1 - y) * job.width * 4];
+        unsigned char* destination = &image.rgb[(size_t)y * job.width * 3];
+        for (int x = 0; x < job.width; ++x)
+        {
+            destination[x * 3 + 0] = source[x * 4 + 0];
+            destination[x * 3 + 1] = source[x * 4 + 1];
+            destination[x * 3 + 2] = source[x * 4 + 2];
+        }
+    }
+
+    char fileName[64];
+    snprintf(fileName, sizeof(fileName), "frame_%05u.ppm", job.frameNumber);
+    std::string path = mDirectory + "/" + fileName;
+    writePpm(path.c_str(), image);
+
+    if (mGoldenDirectory.empty())
+        return;
+
+    std::string goldenPath = mGoldenDirectory + "/" + fileName;
+    Image golden;
+    bool match = false;
+    if (readPpm(goldenPath.c_str(), golden))
+    {
+        ImageComparison comparison = compareImages(image, golden, mTolerance);
+        match = imagesMatch(comparison, image.width, image.height, mMaxDifferentFraction);
+        if (!match)
+        {
+            std::cout << "FrameCapture: " << path << " differs from " << goldenPath << " (" << comparison.differentPixels
+                      << " pixels over tolerance " << mTolerance << ", max difference " << comparison.maxDifference << ")" << std::endl;
+        }
+    }
+
+    if (!match)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mGoldenMismatches++;
+    }
+}
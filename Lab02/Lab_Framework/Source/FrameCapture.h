@@ -0,0 +1,74 @@
+//
+// COMP 371 Labs Framework
+//
+// Asynchronous frame capture -- COMP371 Assignment 2
+//
+// Frames are read back through PixelReadback, so the render loop never waits on
+// glReadPixels, and the pixels are handed to a writer thread that flips them, saves
+// a PPM and, with a golden directory set, compares against the image of the same
+// name there. The render thread never touches the disk so captures can run during
+// benchmarks.
+// The directories have to exist already.
+
+#pragma once
+
+#include "PixelReadback.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+class FrameCapture
+{
+public:
+    FrameCapture();
+    ~FrameCapture();
+
+    // Frames go to directory/frame_NNNNN.ppm. goldenDirectory may be NULL; otherwise
+    // every frame is compared with the same file name there.
+    bool create(const char* directory, const char* goldenDirectory, int tolerance, double maxDifferentFraction);
+
+    // Waits for the outstanding readbacks and writes, returns how many frames differed
+    // from their golden image (missing golden images count)
+    unsigned int destroy();
+
+    // Call once per frame after rendering and before swapping. Collects the readbacks that
+    // are PixelReadback::Lag frames old, and starts reading the width x height back buffer
+    // when capture is true.
+    void endFrame(unsigned int frameNumber, bool capture, int width, int height);
+
+    unsigned int framesCaptured() const { return mFramesCaptured; }
+
+private:
+    struct WriteJob
+    {
+        unsigned int frameNumber;
+        int width;
+        int height;
+        std::vector<unsigned char> rgba;    // bottom row first, as GL reads it
+    };
+
+    void queueFrame(const unsigned char* rgba, unsigned int frameNumber, int width, int height);
+    void writerLoop();
+    void writeFrame(WriteJob& job);
+
+    PixelReadback mReadback;
+    unsigned int mFramesCaptured;
+
+    std::string mDirectory;
+    std::string mGoldenDirectory;
+    int mTolerance;
+    double mMaxDifferentFraction;
+
+    // shared with the writer thread
+    std::thread mWriter;
+    std::mutex mMutex;
+    std::condition_variable mWorkAvailable;
+    std::vector<WriteJob> mJobs;                            // swapped out whole by the writer
+    std::vector<std::vector<unsigned char> > mSpareBuffers; // written frames' pixels, reused
+    bool mStopping;
+    unsigned int mGoldenMismatches;
+};
@@ -0,0 +1,176 @@
+//
+// COMP 371 Labs Framework
+//
+// Frame pacing -- COMP371 Assignment 2
+
+#include "FramePacer.h"
+
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#pragma comment(lib, "winmm.lib")
+#endif
+
+
+static const char* swapModeName(SwapMode mode)
+{
+    switch (mode)
+    {
+    case SWAP_VSYNC_OFF: return "vsync off";
+    case SWAP_VSYNC_ON: return "vsync on";
+    case SWAP_ADAPTIVE: return "adaptive vsync";
+    }
+    return "";
+}
+
+
+FramePacer::FramePacer()
+    : mSwapMode(SWAP_VSYNC_ON)
+    , mTargetFrameTime(Clock::duration::zero())
+    , mSleepMargin(std::chrono::milliseconds(2))
+    , mTimerPeriodSet(false)
+    , mHasLastSwap(false)
+    , mIntervalCount(0)
+    , mMissedFrames(0)
+{
+}
+
+
+void FramePacer::create(SwapMode mode, double framesPerSecond)
+{
+    if (mode == SWAP_ADAPTIVE && !glfwExtensionSupported("WGL_EXT_swap_control_tear") && !glfwExtensionSupported("GLX_EXT_swap_control_tear"))
+    {
+        printf("FramePacer: EXT_swap_control_tear is not supported, using vsync\n");
+        mode = SWAP_VSYNC_ON;
+    }
+    mSwapMode = mode;
+    glfwSwapInterval(mode == SWAP_ADAPTIVE ? -1 : mode == SWAP_VSYNC_ON ? 1 : 0);
+
+    mTargetFrameTime = Clock::duration::zero();
+    if (framesPerSecond > 0.0)
+    {
+        mTargetFrameTime = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / framesPerSecond));
+
+#ifdef _WIN32
+        // the default scheduler tick is 15.6 ms, far too coarse to sleep through most of a frame
+        mTimerPeriodSet = timeBeginPeriod(1) == TIMERR_NOERROR;
+#endif
+    }
+
+    mDeadline = Clock::now() + mTargetFrameTime;
+    mHasLastSwap = false;
+    mIntervalCount = 0;
+    mMissedFrames = 0;
+}
+
+
+void FramePacer::destroy()
+{
+#ifdef _WIN32
+    if (mTimerPeriodSet)
+        timeEndPeriod(1);
+#endif
+    mTimerPeriodSet = false;
+
+    FramePacingStats summary = stats();
+    if (summary.frames == 0)
+        return;
+
+    double target = std::chrono::duration<double, std::milli>(mTargetFrameTime).count();
+    printf("Frame pacing, %s", swapModeName(mSwapMode));
+    if (target > 0.0)
+        printf(", limited to %.3f ms", target);
+    printf(": last %u frames %.3f ms mean, %.3f ms std dev, %.3f-%.3f ms, 99th percentile %.3f ms",
+           summary.frames, summary.meanMs, summary.standardDeviationMs, summary.minMs, summary.maxMs, summary.percentile99Ms);
+    if (target > 0.0)
+        printf(", %u missed", summary.missedFrames);
+    printf("\n");
+}
+
+
+void FramePacer::waitForFrame()
+{
+    if (mTargetFrameTime == Clock::duration::zero())
+        return;
+
+    Clock::time_point now = Clock::now();
+
+    // more than a frame late, start over from now rather than rush the next frames
+    if (now > mDeadline + mTargetFrameTime)
+        mDeadline = now;
+
+    // sleep through most of the wait; the OS wakes us late by a varying amount, so
+    // stop early by the worst recent oversleep and spin the remainder
+    if (mDeadline - now > mSleepMargin)
+    {
+        Clock::time_point wake = mDeadline - mSleepMargin;
+        std::this_thread::sleep_until(wake);
+
+        Clock::duration oversleep = Clock::now() - wake;
+        if (oversleep > mSleepMargin)
+            mSleepMargin = oversleep;
+        else
+            mSleepMargin = mSleepMargin - (mSleepMargin - oversleep) / 16;
+        if (mSleepMargin < std::chrono::microseconds(250))
+            mSleepMargin = std::chrono::microseconds(250);
+    }
+
+    while (Clock::now() < mDeadline)
+        std::this_thread::yield();
+
+    mDeadline += mTargetFrameTime;
+}
+
+
+void FramePacer::frameSwapped()
+{
+    Clock::time_point now = Clock::now();
+    if (mHasLastSwap)
+    {
+        Clock::duration interval = now - mLastSwap;
+        mIntervals[mIntervalCount % HistorySize] = (float)std::chrono::duration<double, std::milli>(interval).count();
+        mIntervalCount++;
+        if (mTargetFrameTime != Clock::duration::zero() && interval > mTargetFrameTime * 3 / 2)
+            mMissedFrames++;
+    }
+    mLastSwap = now;
+    mHasLastSwap = true;
+}
+
+
+FramePacingStats FramePacer::stats() const
+{
+    FramePacingStats result = {};
+    result.frames = mIntervalCount < (unsigned int)HistorySize ? mIntervalCount : HistorySize;
+    result.missedFrames = mMissedFrames;
+    if (result.frames == 0)
+        return result;
+
+    float sorted[HistorySize];
+    double sum = 0.0;
+    for (unsigned int i = 0; i < result.frames; ++i)
+    {
+        sorted[i] = mIntervals[i];
+        sum += mIntervals[i];
+    }
+    result.meanMs = sum / result.frames;
+
+    double squares = 0.0;
+    for (unsigned int i = 0; i < result.frames; ++i)
+        squares += (mIntervals[i] - result.meanMs) * (mIntervals[i] - result.meanMs);
+    result.standardDeviationMs = sqrt(squares / result.frames);
+
+    std::sort(sorted, sorted + result.frames);
+    result.minMs = sorted[0];
+    result.maxMs = sorted[result.frames - 1];
+    result.percentile99Ms = sorted[(result.frames - 1) * 99 / 100];
+    return result;
+}
@@ -0,0 +1,77 @@
+//
+// COMP 371 Labs Framework
+//
+// Frame pacing -- COMP371 Assignment 2
+//
+// Sets the swap interval and optionally caps the frame rate. The limiter sleeps
+// until shortly before the frame's deadline and spins with yields for the rest,
+// learning how late the OS wakes it up so the spin stays short. Deadlines advance
+// by exactly the target frame time, so one late frame does not shift the ones
+// after it; a frame more than a whole interval late starts a new schedule instead
+// of rushing to catch up. Every swap-to-swap interval goes into a small history
+// for the jitter statistics. Belongs to the thread that swaps.
+
+#pragma once
+
+#include <chrono>
+
+
+enum SwapMode
+{
+    SWAP_VSYNC_OFF = 0,
+    SWAP_VSYNC_ON,
+    SWAP_ADAPTIVE       // vsync, but a late frame tears instead of waiting a whole refresh (EXT_swap_control_tear)
+};
+
+
+struct FramePacingStats
+{
+    unsigned int frames;        // in the history, at most HistorySize
+    double meanMs;
+    double standardDeviationMs;
+    double minMs;
+    double maxMs;
+    double percentile99Ms;
+    unsigned int missedFrames;  // over 1.5 target frame times, only counted with a limiter
+};
+
+
+class FramePacer
+{
+public:
+    static const int HistorySize = 512;
+
+    FramePacer();
+
+    // Needs the window's context current on the calling thread. framesPerSecond 0
+    // leaves the rate to the swap interval. Adaptive falls back to vsync on when the
+    // extension is missing.
+    void create(SwapMode mode, double framesPerSecond);
+
+    // Prints the pacing summary
+    void destroy();
+
+    // Call right before swapping, returns once the frame is due
+    void waitForFrame();
+
+    // Call right after swapping
+    void frameSwapped();
+
+    FramePacingStats stats() const;
+    SwapMode swapMode() const { return mSwapMode; }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    SwapMode mSwapMode;
+    Clock::duration mTargetFrameTime;   // zero without a limiter
+    Clock::time_point mDeadline;
+    Clock::duration mSleepMargin;       // how early to stop sleeping and start spinning
+    bool mTimerPeriodSet;
+
+    Clock::time_point mLastSwap;
+    bool mHasLastSwap;
+    float mIntervals[HistorySize];      // milliseconds, a ring
+    unsigned int mIntervalCount;        // total, the ring holds the last HistorySize
+    unsigned int mMissedFrames;
+};
@@ -0,0 +1,72 @@
+//
+// COMP 371 Labs Framework
+//
+// Simulation to render hand-off -- COMP371 Assignment 2
+//
+// Everything the render thread needs to draw one frame, filled in by the main
+// thread after input and simulation. Packets are recycled, so the vectors keep
+// their capacity and a steady-state frame does not allocate.
+
+#pragma once
+
+#define GLEW_STATIC 1
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "Affine.h"
+#include "CrowdRenderer.h"
+#include "MeshLibrary.h"
+#include "MeshSimplifier.h"
+#include "Minimap.h"
+#include "SceneShader.h"
+
+
+// One viewport of the frame, in framebuffer pixels
+struct FrameView
+{
+    glm::mat4 viewMatrix;
+    glm::mat4 viewProjection;
+    int x, y, width, height;
+};
+
+
+struct FramePacket
+{
+    unsigned int frameNumber;
+    float time;             // glfwGetTime() when the frame was simulated
+    float dt;
+
+    // cameras, views[0] is the main one and the one depth sorting uses
+    int viewCount;
+    FrameView views[SCENE_MAX_VIEWS];
+    glm::mat4 worldMatrix;  // the arrow key world rotation, only reaches the main shader's uniform
+
+    int framebufferWidth;
+    int framebufferHeight;
+
+    GLenum olafRenderMode;
+    Affine3x4 olafParts[SNOWMAN_PART_COUNT];    // world transforms by SnowmanPart
+
+    // Crowd, GPU culling: the instances that changed this frame, starting at instance
+    // crowdInstanceFirst of crowdInstanceTotal; all of them when the count is the total
+    bool crowdInstancesChanged;
+    size_t crowdInstanceFirst;
+    size_t crowdInstanceTotal;
+    std::vector<CrowdInstance> crowdInstances;
+
+    // Crowd, CPU culling: what the culling system found visible
+    CrowdDrawList crowdDrawList;
+
+    // Minimap: new markers to redraw it with, only valid when they changed this frame
+    bool minimapChanged;
+    std::vector<MinimapMarker> minimapMarkers;
+
+    // LOD chains from --simplify, one per MeshId, set on the first packet only. They
+    // stay with the main thread, which keeps them until the renderer is destroyed.
+    const LodChain* lodChains;
+
+    bool toggleStats;       // F1 was pressed
+};
@@ -0,0 +1,52 @@
+//
+// COMP 371 Labs Framework
+//
+// View frustum planes and bounding sphere tests -- COMP371 Assignment 2
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+
+struct Frustum
+{
+    // left, right, bottom, top, near, far; xyz is the inward normal, w the distance
+    glm::vec4 planes[6];
+};
+
+
+// Gribb/Hartmann plane extraction from a view-projection matrix
+inline Frustum extractFrustum(const glm::mat4& viewProjection)
+{
+    // glm is column major, rows of the matrix are m[0][i], m[1][i], m[2][i], m[3][i]
+    glm::vec4 row0(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+    glm::vec4 row1(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+    glm::vec4 row2(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+    glm::vec4 row3(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+
+    Frustum frustum;
+    frustum.planes[0] = row3 + row0;
+    frustum.planes[1] = row3 - row0;
+    frustum.planes[2] = row3 + row1;
+    frustum.planes[3] = row3 - row1;
+    frustum.planes[4] = row3 + row2;
+    frustum.planes[5] = row3 - row2;
+
+    // normalized so the sphere test can compare against the radius directly
+    for (int i = 0; i < 6; ++i)
+        frustum.planes[i] /= glm::length(glm::vec3(frustum.planes[i]));
+
+    return frustum;
+}
+
+
+inline bool sphereInFrustum(const Frustum& frustum, const glm::vec3& center, float radius)
+{
+    for (int i = 0; i < 6; ++i)
+    {
+        const glm::vec4& plane = frustum.planes[i];
+        if (plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w < -radius)
+            return false;
+    }
+    return true;
+}
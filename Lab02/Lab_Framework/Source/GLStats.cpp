@@ -0,0 +1,248 @@
+//
+// COMP 371 Labs Framework
+//
+// GL call counting and pipeline statistics -- COMP371 Assignment 2
+
+#include "GLStats.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+
+namespace GLStats
+{
+    bool gEnabled = false;
+    GLFrameStats gCurrentFrame;
+
+    // queries are read back this many frames after they were issued
+    static const int QueryFrameCount = 3;
+    static const int QueryTargetCount = 4;
+    static const GLenum QueryTargets[QueryTargetCount] = {
+        GL_VERTEX_SHADER_INVOCATIONS_ARB,
+        GL_FRAGMENT_SHADER_INVOCATIONS_ARB,
+        GL_CLIPPING_INPUT_PRIMITIVES_ARB,
+        GL_CLIPPING_OUTPUT_PRIMITIVES_ARB
+    };
+
+    static bool sPipelineQueries = false;
+    static GLuint sQueries[QueryFrameCount][QueryTargetCount];
+    static bool sQueryIssued[QueryFrameCount];
+    static int sQueryFrame = 0;
+    static bool sFrameOpen = false;
+
+    static GLFrameStats sLastFrame;
+    static GLFrameStats sLastPipeline; // newest pipeline statistics read back
+    static std::vector<GLFrameStats> sHistory;
+    static size_t sHistoryCapacity = 0;
+
+
+    static void resetCounts(GLFrameStats& stats)
+    {
+        memset(&stats, 0, sizeof(GLFrameStats));
+    }
+
+
+    void initialize(bool enabled)
+    {
+        resetCounts(gCurrentFrame);
+        resetCounts(sLastFrame);
+        resetCounts(sLastPipeline);
+
+        sPipelineQueries = GLEW_ARB_pipeline_statistics_query != 0;
+        if (sPipelineQueries)
+        {
+            for (int frame = 0; frame < QueryFrameCount; ++frame)
+            {
+                glGenQueries(QueryTargetCount, sQueries[frame]);
+                sQueryIssued[frame] = false;
+            }
+        }
+        else
+        {
+            std::cout << "GLStats: ARB_pipeline_statistics_query not supported, only counting calls" << std::endl;
+        }
+
+        setEnabled(enabled);
+    }
+
+
+    void shutdown()
+    {
+        if (sPipelineQueries)
+        {
+            for (int frame = 0; frame < QueryFrameCount; ++frame)
+                glDeleteQueries(QueryTargetCount, sQueries[frame]);
+        }
+        sPipelineQueries = false;
+    }
+
+
+    void setEnabled(bool enabled)
+    {
+        gEnabled = LIGMA_GL_STATS && enabled;
+    }
+
+
+    static void readBackQueries(int frame)
+    {
+        if (!sQueryIssued[frame])
+            return;
+
+        // only take results that are already there, never wait on the GPU
+        GLuint available = GL_FALSE;
+        glGetQueryObjectuiv(sQueries[frame][QueryTargetCount - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            return;
+
+        GLuint64 results[QueryTargetCount];
+        for (int i = 0; i < QueryTargetCount; ++i)
+            glGetQueryObjectui64v(sQueries[frame][i], GL_QUERY_RESULT, &results[i]);
+
+        sLastPipeline.hasPipelineStatistics = true;
+        sLastPipeline.vertexShaderInvocations = results[0];
+        sLastPipeline.fragmentShaderInvocations = results[1];
+        sLastPipeline.clippingInputPrimitives = results[2];
+        sLastPipeline.clippingOutputPrimitives = results[3];
+        sQueryIssued[frame] = false;
+    }
+
+
+    void beginFrame()
+    {
+        resetCounts(gCurrentFrame);
+        sFrameOpen = false;
+
+        if (!isEnabled() || !sPipelineQueries)
+            return;
+
+        // the slot we are about to reuse was issued QueryFrameCount frames ago
+        sQueryFrame = (sQueryFrame + 1) % QueryFrameCount;
+        readBackQueries(sQueryFrame);
+        if (sQueryIssued[sQueryFrame])
+            return; // still in flight, skip measuring this frame rather than stalling
+
+        for (int i = 0; i < QueryTargetCount; ++i)
+            glBeginQuery(QueryTargets[i], sQueries[sQueryFrame][i]);
+        sFrameOpen = true;
+    }
+
+
+    void endFrame(float frameTime)
+    {
+        if (sFrameOpen)
+        {
+            for (int i = 0; i < QueryTargetCount; ++i)
+                glEndQuery(QueryTargets[i]);
+            sQueryIssued[sQueryFrame] = true;
+            sFrameOpen = false;
+        }
+
+        // pick up anything else that finished in the meantime
+        if (isEnabled() && sPipelineQueries)
+        {
+            for (int frame = 0; frame < QueryFrameCount; ++frame)
+            {
+                if (frame != sQueryFrame)
+                    readBackQueries(frame);
+            }
+        }
+
+        sLastFrame = gCurrentFrame;
+        sLastFrame.frameTime = frameTime;
+        sLastFrame.hasPipelineStatistics = sLastPipeline.hasPipelineStatistics;
+        sLastFrame.vertexShaderInvocations = sLastPipeline.vertexShaderInvocations;
+        sLastFrame.fragmentShaderInvocations = sLastPipeline.fragmentShaderInvocations;
+        sLastFrame.clippingInputPrimitives = sLastPipeline.clippingInputPrimitives;
+        sLastFrame.clippingOutputPrimitives = sLastPipeline.clippingOutputPrimitives;
+
+        if (sHistory.size() < sHistoryCapacity)
+            sHistory.push_back(sLastFrame);
+    }
+
+
+    const GLFrameStats& lastFrame()
+    {
+        return sLastFrame;
+    }
+
+
+    void recordHistory(size_t frameCount)
+    {
+        sHistory.clear();
+        sHistory.reserve(frameCount);
+        sHistoryCapacity = frameCount;
+    }
+
+
+    const std::vector<GLFrameStats>& history()
+    {
+        return sHistory;
+    }
+
+
+    const char* formatSummary(const GLFrameStats& stats, char* buffer, size_t bufferSize)
+    {
+        int length = snprintf(buffer, bufferSize, "%.2fms | draws %u | state %u | uniforms %u | uploads %u",
+            stats.frameTime * 1000.0f, stats.calls[GL_CALL_DRAW], stats.stateChanges(),
+            stats.calls[GL_CALL_UNIFORM], stats.calls[GL_CALL_BUFFER_UPLOAD]);
+
+        if (stats.hasPipelineStatistics && length > 0 && (size_t)length < bufferSize)
+        {
+            snprintf(buffer + length, bufferSize - length, " | vs %llu | fs %llu | clipped %llu",
+                (unsigned long long)stats.vertexShaderInvocations,
+                (unsigned long long)stats.fragmentShaderInvocations,
+                (unsigned long long)(stats.clippingInputPrimitives - stats.clippingOutputPrimitives));
+        }
+
+        return buffer;
+    }
+
+
+    bool writeJson(const char* path)
+    {
+        FILE* file = fopen(path, "w");
+        if (file == NULL)
+        {
+            std::cerr << "GLStats: could not open " << path << " for writing" << std::endl;
+            return false;
+        }
+
+        static const char* callNames[GL_CALL_TYPE_COUNT] = {
+            "draws", "useProgram", "bindVertexArray", "enableDisable", "uniforms", "bindBuffer", "bufferUploads", "dispatches"
+        };
+
+        double totalTime = 0.0;
+        for (size_t i = 0; i < sHistory.size(); ++i)
+            totalTime += sHistory[i].frameTime;
+
+        fprintf(file, "{\n");
+        fprintf(file, "  \"frameCount\": %u,\n", (unsigned int)sHistory.size());
+        fprintf(file, "  \"averageFrameTimeMs\": %.4f,\n", sHistory.empty() ? 0.0 : totalTime * 1000.0 / sHistory.size());
+        fprintf(file, "  \"pipelineStatistics\": %s,\n", sPipelineQueries ? "true" : "false");
+        fprintf(file, "  \"frames\": [\n");
+
+        for (size_t i = 0; i < sHistory.size(); ++i)
+        {
+            const GLFrameStats& stats = sHistory[i];
+            fprintf(file, "    { \"frameTimeMs\": %.4f", stats.frameTime * 1000.0f);
+            for (int type = 0; type < GL_CALL_TYPE_COUNT; ++type)
+                fprintf(file, ", \"%s\": %u", callNames[type], stats.calls[type]);
+            fprintf(file, ", \"stateChanges\": %u", stats.stateChanges());
+
+            if (stats.hasPipelineStatistics)
+            {
+                fprintf(file, ", \"vertexShaderInvocations\": %llu, \"fragmentShaderInvocations\": %llu, \"clippingInputPrimitives\": %llu, \"clippingOutputPrimitives\": %llu",
+                    (unsigned long long)stats.vertexShaderInvocations, (unsigned long long)stats.fragmentShaderInvocations,
+                    (unsigned long long)stats.clippingInputPrimitives, (unsigned long long)stats.clippingOutputPrimitives);
+            }
+
+            fprintf(file, " }%s\n", i + 1 < sHistory.size() ? "," : "");
+        }
+
+        fprintf(file, "  ]\n");
+        fprintf(file, "}\n");
+        fclose(file);
+        return true;
+    }
+}
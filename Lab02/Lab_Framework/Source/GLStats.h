@@ -0,0 +1,211 @@
+//
+// COMP 371 Labs Framework
+//
+// GL call counting and pipeline statistics -- COMP371 Assignment 2
+//
+// The stats* functions below wrap the GL entry points the renderer uses and count
+// them per frame by type. Compile with LIGMA_GL_STATS=0 to turn the wrappers into
+// plain forwards; otherwise counting is switched on at runtime with setEnabled().
+// When ARB_pipeline_statistics_query is there, vertex shader invocations, fragment
+// shader invocations and clipper primitives are queried too, read back a couple of
+// frames late so the queries never stall.
+
+#pragma once
+
+#define GLEW_STATIC 1
+#include <GL/glew.h>
+
+#include <vector>
+
+#ifndef LIGMA_GL_STATS
+#define LIGMA_GL_STATS 1
+#endif
+
+
+enum GLCallType
+{
+    GL_CALL_DRAW = 0,
+    GL_CALL_USE_PROGRAM,
+    GL_CALL_BIND_VERTEX_ARRAY,
+    GL_CALL_CAPABILITY,     // glEnable / glDisable
+    GL_CALL_UNIFORM,
+    GL_CALL_BIND_BUFFER,    // glBindBuffer / glBindBufferRange
+    GL_CALL_BUFFER_UPLOAD,  // glBufferData / glBufferSubData / glMapBufferRange
+    GL_CALL_DISPATCH,       // glDispatchCompute
+
+    GL_CALL_TYPE_COUNT
+};
+
+
+struct GLFrameStats
+{
+    unsigned int calls[GL_CALL_TYPE_COUNT];
+
+    // only valid when hasPipelineStatistics, and a few frames older than the call counts
+    bool hasPipelineStatistics;
+    GLuint64 vertexShaderInvocations;
+    GLuint64 fragmentShaderInvocations;
+    GLuint64 clippingInputPrimitives;
+    GLuint64 clippingOutputPrimitives;
+
+    float frameTime; // seconds
+
+    unsigned int stateChanges() const
+    {
+        return calls[GL_CALL_USE_PROGRAM] + calls[GL_CALL_BIND_VERTEX_ARRAY] + calls[GL_CALL_CAPABILITY] + calls[GL_CALL_BIND_BUFFER];
+    }
+};
+
+
+namespace GLStats
+{
+    extern bool gEnabled;
+    extern GLFrameStats gCurrentFrame;
+
+    // Creates the pipeline queries, needs a current context
+    void initialize(bool enabled);
+    void shutdown();
+
+    void setEnabled(bool enabled);
+    inline bool isEnabled() { return LIGMA_GL_STATS && gEnabled; }
+
+    inline void count(GLCallType type)
+    {
+#if LIGMA_GL_STATS
+        if (gEnabled)
+            gCurrentFrame.calls[type]++;
+#endif
+    }
+
+    // Bracket everything the frame renders
+    void beginFrame();
+    void endFrame(float frameTime);
+
+    // Counts for the last finished frame, with the newest pipeline statistics that came back
+    const GLFrameStats& lastFrame();
+
+    // Keeps every finished frame, meant for benchmark runs (reserve the frame count up front)
+    void recordHistory(size_t frameCount);
+    const std::vector<GLFrameStats>& history();
+
+    // One line summary for the window title or console, returns buffer
+    const char* formatSummary(const GLFrameStats& stats, char* buffer, size_t bufferSize);
+
+    // Writes the recorded history and averages as JSON
+    bool writeJson(const char* path);
+}
+
+
+inline void statsDrawArrays(GLenum mode, GLint first, GLsizei count)
+{
+    GLStats::count(GL_CALL_DRAW);
+    glDrawArrays(mode, first, count);
+}
+
+inline void statsDrawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instanceCount)
+{
+    GLStats::count(GL_CALL_DRAW);
+    glDrawArraysInstanced(mode, first, count, instanceCount);
+}
+
+inline void statsDrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices)
+{
+    GLStats::count(GL_CALL_DRAW);
+    glDrawElements(mode, count, type, indices);
+}
+
+inline void statsDrawElementsInstancedBaseVertex(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instanceCount, GLint baseVertex)
+{
+    GLStats::count(GL_CALL_DRAW);
+    glDrawElementsInstancedBaseVertex(mode, count, type, indices, instanceCount, baseVertex);
+}
+
+inline void statsMultiDrawElementsIndirect(GLenum mode, GLenum type, const void* indirect, GLsizei drawCount, GLsizei stride)
+{
+    GLStats::count(GL_CALL_DRAW);
+    glMultiDrawElementsIndirect(mode, type, indirect, drawCount, stride);
+}
+
+inline void statsDispatchCompute(GLuint groupsX, GLuint groupsY, GLuint groupsZ)
+{
+    GLStats::count(GL_CALL_DISPATCH);
+    glDispatchCompute(groupsX, groupsY, groupsZ);
+}
+
+inline void statsUseProgram(GLuint program)
+{
+    GLStats::count(GL_CALL_USE_PROGRAM);
+    glUseProgram(program);
+}
+
+inline void statsBindVertexArray(GLuint vertexArray)
+{
+    GLStats::count(GL_CALL_BIND_VERTEX_ARRAY);
+    glBindVertexArray(vertexArray);
+}
+
+inline void statsEnable(GLenum capability)
+{
+    GLStats::count(GL_CALL_CAPABILITY);
+    glEnable(capability);
+}
+
+inline void statsDisable(GLenum capability)
+{
+    GLStats::count(GL_CALL_CAPABILITY);
+    glDisable(capability);
+}
+
+inline void statsUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value)
+{
+    GLStats::count(GL_CALL_UNIFORM);
+    glUniformMatrix4fv(location, count, transpose, value);
+}
+
+inline void statsBindBuffer(GLenum target, GLuint buffer)
+{
+    GLStats::count(GL_CALL_BIND_BUFFER);
+    glBindBuffer(target, buffer);
+}
+
+inline void statsBindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+    GLStats::count(GL_CALL_BIND_BUFFER);
+    glBindBufferRange(target, index, buffer, offset, size);
+}
+
+inline void statsBindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+    GLStats::count(GL_CALL_BIND_BUFFER);
+    glBindBufferBase(target, index, buffer);
+}
+
+inline void statsUniform4fv(GLint location, GLsizei count, const GLfloat* value)
+{
+    GLStats::count(GL_CALL_UNIFORM);
+    glUniform4fv(location, count, value);
+}
+
+inline void statsUniform1ui(GLint location, GLuint value)
+{
+    GLStats::count(GL_CALL_UNIFORM);
+    glUniform1ui(location, value);
+}
+
+inline void statsBufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage)
+{
+    GLStats::count(GL_CALL_BUFFER_UPLOAD);
+    glBufferData(target, size, data, usage);
+}
+
+inline void statsBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data)
+{
+    GLStats::count(GL_CALL_BUFFER_UPLOAD);
+    glBufferSubData(target, offset, size, data);
+}
+
+inline void* statsMapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access)
+{
+    GLStats::count(GL_CALL_BUFFER_UPLOAD);
+    return glMapBufferRange(target, offset, length, access);
+}
@@ -0,0 +1,147 @@
+//
+// COMP 371 Labs Framework
+//
+// RGB images and golden image comparison -- COMP371 Assignment 2
+
+#include "Image.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+
+// Next number in a PPM header, skipping whitespace and # comments
+static bool readPpmNumber(FILE* file, int& value)
+{
+    int c = fgetc(file);
+    while (c != EOF)
+    {
+        if (c == '#')
+        {
+            while (c != EOF && c != '\n')
+                c = fgetc(file);
+        }
+        else if (c != ' ' && c != '\t' && c != '\r' && c != '\n')
+            break;
+        c = fgetc(file);
+    }
+
+    value = 0;
+    bool any = false;
+    while (c >= '0' && c <= '9')
+    {
+        value = value * 10 + (c - '0');
+        any = true;
+        c = fgetc(file);
+    }
+    // c is the single whitespace that ends the number, the pixel data starts right after it
+    return any;
+}
+
+
+bool readPpm(const char* path, Image& image)
+{
+    FILE* file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        std::cerr << "Image: could not open " << path << std::endl;
+        return false;
+    }
+
+    int maxValue = 0;
+    bool valid = fgetc(file) == 'P' && fgetc(file) == '6'
+              && readPpmNumber(file, image.width) && readPpmNumber(file, image.height) && readPpmNumber(file, maxValue)
+              && image.width > 0 && image.height > 0 && maxValue == 255;
+    if (!valid)
+    {
+        std::cerr << "Image: " << path << " is not an 8 bit binary PPM" << std::endl;
+        fclose(file);
+        return false;
+    }
+
+    image.rgb.resize((size_t)image.width * image.height * 3);
+    bool complete = fread(&image.rgb[0], 1, image.rgb.size(), file) == image.rgb.size();
+    fclose(file);
+
+    if (!complete)
+        std::cerr << "Image: " << path << " is truncated" << std::endl;
+    return complete;
+}
+
+
+bool writePpm(const char* path, const Image& image)
+{
+    FILE* file = fopen(path, "wb");
+    if (file == NULL)
+    {
+        std::cerr << "Image: could not open " << path << " for writing" << std::endl;
+        return false;
+    }
+
+    fprintf(file, "P6\n%d %d\n255\n", image.width, image.height);
+    bool complete = image.rgb.empty() || fwrite(&image.rgb[0], 1, image.rgb.size(), file) == image.rgb.size();
+    fclose(file);
+
+    if (!complete)
+        std::cerr << "Image: failed writing " << path << std::endl;
+    return complete;
+}
+
+
+ImageComparison compareImages(const Image& image, const Image& golden, int tolerance)
+{
+    ImageComparison comparison = { false, 0, 0, 0.0 };
+    if (image.width != golden.width || image.height != golden.height || image.rgb.size() != golden.rgb.size())
+        return comparison;
+
+    comparison.sameSize = true;
+    unsigned long long totalDifference = 0;
+    for (size_t i = 0; i < image.rgb.size(); i += 3)
+    {
+        int pixelDifference = 0;
+        for (int channel = 0; channel < 3; ++channel)
+        {
+            int difference = abs((int)image.rgb[i + channel] - (int)golden.rgb[i + channel]);
+            totalDifference += difference;
+            if (difference > pixelDifference)
+                pixelDifference = difference;
+        }
+
+        if (pixelDifference > tolerance)
+            comparison.differentPixels++;
+        if (pixelDifference > comparison.maxDifference)
+            comparison.maxDifference = pixelDifference;
+    }
+
+    if (!image.rgb.empty())
+        comparison.meanDifference = (double)totalDifference / image.rgb.size();
+    return comparison;
+}
+
+
+bool imagesMatch(const ImageComparison& comparison, int width, int height, double maxDifferentFraction)
+{
+    return comparison.sameSize && comparison.differentPixels <= maxDifferentFraction * width * height;
+}
+
+
+bool compareImageFiles(const char* path, const char* goldenPath, int tolerance, double maxDifferentFraction)
+{
+    Image image, golden;
+    if (!readPpm(path, image) || !readPpm(goldenPath, golden))
+        return false;
+
+    ImageComparison comparison = compareImages(image, golden, tolerance);
+    if (!comparison.sameSize)
+    {
+        std::cout << path << ": " << image.width << "x" << image.height << " but golden " << goldenPath
+                  << " is " << golden.width << "x" << golden.height << std::endl;
+        return false;
+    }
+
+    bool match = imagesMatch(comparison, image.width, image.height, maxDifferentFraction);
+    std::cout << path << (match ? ": matches " : ": DIFFERS from ") << goldenPath << " (" << comparison.differentPixels
+              << " pixels over tolerance " << tolerance << ", max difference " << comparison.maxDifference
+              << ", mean " << comparison.meanDifference << ")" << std::endl;
+    return match;
+}
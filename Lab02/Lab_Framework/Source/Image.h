@@ -0,0 +1,46 @@
+//
+// COMP 371 Labs Framework
+//
+// RGB images and golden image comparison -- COMP371 Assignment 2
+//
+// Captured frames are written as binary PPM (P6): no library needed and every
+// image viewer opens them. compareImages() is what visual regression runs use,
+// a frame matches its golden image when few enough pixels differ by more than
+// the per channel tolerance, so small rasterization differences between drivers
+// do not fail a run.
+
+#pragma once
+
+#include <vector>
+
+
+struct Image
+{
+    int width;
+    int height;
+    std::vector<unsigned char> rgb; // tightly packed rows, top row first
+
+    Image() : width(0), height(0) {}
+};
+
+
+struct ImageComparison
+{
+    bool sameSize;
+    unsigned int differentPixels;   // pixels with a channel off by more than the tolerance
+    int maxDifference;              // largest channel difference anywhere
+    double meanDifference;          // mean absolute channel difference
+};
+
+
+bool readPpm(const char* path, Image& image);
+bool writePpm(const char* path, const Image& image);
+
+// Images of different sizes never match
+ImageComparison compareImages(const Image& image, const Image& golden, int tolerance);
+
+// maxDifferentFraction is how much of the image may be off by more than tolerance
+bool imagesMatch(const ImageComparison& comparison, int width, int height, double maxDifferentFraction);
+
+// The --compare tool: loads both files, prints the differences, returns true when they match
+bool compareImageFiles(const char* path, const char* goldenPath, int tolerance, double maxDifferentFraction);
@@ -0,0 +1,244 @@
+//
+// COMP 371 Labs Framework
+//
+// Billboard impostors -- COMP371 Assignment 2
+
+#include "ImpostorRenderer.h"
+#include "CrowdRenderer.h"
+#include "GLStats.h"
+#include "RenderQueue.h"
+#include "Shaders.h"
+#include "StreamBuffer.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cmath>
+#include <iostream>
+
+using namespace glm;
+
+
+static const char* getImpostorVertexShaderSource()
+{
+    // corners come from the vertex id, everything else is per instance
+    return
+        "#version 330 core\n"
+        "layout (location = 0) in vec4 aBounds;\n"
+        "layout (location = 1) in vec2 aYawRow;\n"
+        "layout (std140) uniform FrameData\n"
+        "{\n"
+        "   mat4 viewProjectionMatrix;\n"
+        "};\n"
+        "uniform vec3 cameraPosition;\n"
+        "uniform vec3 screenRight;\n" // zero unless the view looks nearly along z
+        "uniform vec3 screenUp;\n"
+        "uniform vec2 atlasCells;\n" // angles, rows
+        "out vec2 texCoord;\n"
+        "void main()\n"
+        "{\n"
+        "   vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;\n"
+        "   vec2 toCamera = cameraPosition.xy - aBounds.xy;\n"
+        "   toCamera = dot(toCamera, toCamera) > 1e-6 ? normalize(toCamera) : vec2(1.0, 0.0);\n"
+        "   float angle = atan(toCamera.y, toCamera.x) - aYawRow.x;\n"
+        "   float cell = mod(floor(angle / 6.2831853 * atlasCells.x + 0.5), atlasCells.x);\n"
+        "   texCoord = vec2((cell + corner.x * 0.5 + 0.5) / atlasCells.x, (aYawRow.y + corner.y * 0.5 + 0.5) / atlasCells.y);\n"
+        "   vec3 right = vec3(-toCamera.y, toCamera.x, 0.0);\n"
+        "   vec3 up = vec3(0.0, 0.0, 1.0);\n"
+        "   if (dot(screenRight, screenRight) > 0.0)\n"
+        "   {\n"
+        "       right = screenRight;\n"
+        "       up = screenUp;\n"
+        "   }\n"
+        "   vec3 position = aBounds.xyz + (right * corner.x + up * corner.y) * aBounds.w;\n"
+        "   gl_Position = viewProjectionMatrix * vec4(position, 1.0);\n"
+        "}\n";
+}
+
+
+static const char* getImpostorFragmentShaderSource()
+{
+    return
+        "#version 330 core\n"
+        "uniform sampler2D atlas;\n"
+        "in vec2 texCoord;\n"
+        "out vec4 FragColor;\n"
+        "void main()\n"
+        "{\n"
+        "   vec4 color = texture(atlas, texCoord);\n"
+        "   if (color.a < 0.5)\n"
+        "       discard;\n"
+        "   FragColor = vec4(color.rgb, 1.0);\n"
+        "}\n";
+}
+
+
+ImpostorRenderer::ImpostorRenderer()
+    : mProgram(0), mCameraPositionLocation(-1), mScreenRightLocation(-1), mScreenUpLocation(-1), mAtlasCellsLocation(-1)
+    , mVertexArray(0), mAtlas(0)
+{
+}
+
+
+ImpostorRenderer::~ImpostorRenderer()
+{
+    destroy();
+}
+
+
+bool ImpostorRenderer::create(const MeshLibrary& meshes, GLuint sceneProgram, GLint modelViewProjectionLocation)
+{
+    mProgram = linkProgram(compileShader(GL_VERTEX_SHADER, getImpostorVertexShaderSource()),
+                           compileShader(GL_FRAGMENT_SHADER, getImpostorFragmentShaderSource()));
+    if (mProgram == 0)
+    {
+        std::cerr << "ImpostorRenderer: billboard shader failed" << std::endl;
+        return false;
+    }
+    mCameraPositionLocation = glGetUniformLocation(mProgram, "cameraPosition");
+    mScreenRightLocation = glGetUniformLocation(mProgram, "screenRight");
+    mScreenUpLocation = glGetUniformLocation(mProgram, "screenUp");
+    mAtlasCellsLocation = glGetUniformLocation(mProgram, "atlasCells");
+
+    const GLsizei atlasWidth = AngleCount * CellSize;
+    const GLsizei atlasHeight = IMPOSTOR_MESH_COUNT * CellSize;
+
+    glGenTextures(1, &mAtlas);
+    glBindTexture(GL_TEXTURE_2D, mAtlas);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, atlasWidth, atlasHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    GLuint depthBuffer;
+    glGenRenderbuffers(1, &depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, atlasWidth, atlasHeight);
+
+    GLuint framebuffer;
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mAtlas, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+    if (complete)
+    {
+        // Only done once at load time, the state is read back instead of tracked
+        GLint viewport[4];
+        GLfloat clearColor[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+
+        // Transparent where the mesh is not, the billboards discard it
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glEnable(GL_DEPTH_TEST);
+        glEnable(GL_CULL_FACE);
+        glUseProgram(sceneProgram);
+        glBindVertexArray(meshes.vertexArray());
+
+        // Each cell looks at the mesh's bounding sphere from the side, an orthographic
+        // square the size of the sphere like the billboard that will show it
+        for (int row = 0; row < IMPOSTOR_MESH_COUNT; ++row)
+        {
+            const Mesh& mesh = meshes.mesh(impostorMesh(row));
+            const vec3 center = mesh.boundsCenter;
+            const float radius = mesh.boundsRadius;
+            const mat4 projection = ortho(-radius, radius, -radius, radius, 0.5f * radius, 3.5f * radius);
+
+            for (int cell = 0; cell < AngleCount; ++cell)
+            {
+                float angle = cell * 6.2831853f / AngleCount;
+                vec3 direction(cosf(angle), sinf(angle), 0.0f);
+                mat4 view = lookAt(center + 2.0f * radius * direction, center, vec3(0.0f, 0.0f, 1.0f));
+                mat4 modelViewProjection = projection * view;
+
+                glViewport(cell * CellSize, row * CellSize, CellSize, CellSize);
+                glUniformMatrix4fv(modelViewProjectionLocation, 1, GL_FALSE, &modelViewProjection[0][0]);
+                statsDrawArrays(mesh.mode, mesh.baseVertex, mesh.vertexCount);
+            }
+        }
+
+        glBindVertexArray(0);
+        glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+        glBindTexture(GL_TEXTURE_2D, mAtlas);
+        glGenerateMipmap(GL_TEXTURE_2D);
+    }
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteRenderbuffers(1, &depthBuffer);
+
+    if (!complete)
+    {
+        std::cerr << "ImpostorRenderer: atlas framebuffer is incomplete" << std::endl;
+        destroy();
+        return false;
+    }
+
+    // Instances come from the stream buffer, offsets are set when drawing
+    glGenVertexArrays(1, &mVertexArray);
+    glBindVertexArray(mVertexArray);
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribDivisor(0, 1);
+    glVertexAttribDivisor(1, 1);
+    glBindVertexArray(0);
+    return true;
+}
+
+
+void ImpostorRenderer::destroy()
+{
+    if (mAtlas != 0)
+        glDeleteTextures(1, &mAtlas);
+    if (mVertexArray != 0)
+        glDeleteVertexArrays(1, &mVertexArray);
+    if (mProgram != 0)
+        glDeleteProgram(mProgram);
+    mAtlas = 0;
+    mVertexArray = 0;
+    mProgram = 0;
+}
+
+
+void ImpostorRenderer::draw(GLStateCache& stateCache, StreamBuffer& streamBuffer, const StreamAllocation& impostors, GLsizei count,
+                            const mat4& viewMatrix)
+{
+    if (count == 0 || mAtlas == 0 || impostors.data == NULL)
+        return;
+
+    streamBuffer.flush();
+
+    // the quads always face the camera, nothing to cull
+    stateCache.useProgram(mProgram);
+    stateCache.setRenderState(RENDER_STATE_DEPTH_TEST);
+    stateCache.bindVertexArray(mVertexArray);
+    // A view looking down on the crowd would see quads turning around z edge-on, there
+    // they lie in the screen plane. The columns of the inverse view are the camera axes.
+    mat4 cameraToWorld = inverse(viewMatrix);
+    vec3 cameraPosition = vec3(cameraToWorld[3]);
+    vec3 forward = -vec3(cameraToWorld[2]);
+    vec3 screenRight(0.0f);
+    vec3 screenUp(0.0f);
+    if (std::fabs(forward.z) > 0.9f)
+    {
+        screenRight = vec3(cameraToWorld[0]);
+        screenUp = vec3(cameraToWorld[1]);
+    }
+    glUniform3fv(mCameraPositionLocation, 1, &cameraPosition[0]);
+    glUniform3fv(mScreenRightLocation, 1, &screenRight[0]);
+    glUniform3fv(mScreenUpLocation, 1, &screenUp[0]);
+    glUniform2f(mAtlasCellsLocation, (GLfloat)AngleCount, (GLfloat)IMPOSTOR_MESH_COUNT);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, mAtlas);
+
+    statsBindBuffer(GL_ARRAY_BUFFER, streamBuffer.buffer());
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(CrowdImpostor), (void*)impostors.offset);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(CrowdImpostor), (void*)(impostors.offset + sizeof(vec4)));
+    statsDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, count);
+}
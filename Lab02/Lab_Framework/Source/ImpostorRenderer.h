@@ -0,0 +1,59 @@
+//
+// COMP 371 Labs Framework
+//
+// Billboard impostors -- COMP371 Assignment 2
+//
+// A far away snowman covers a few pixels but still costs four cubes. At load time
+// every triangle mesh is rendered from AngleCount directions around its up axis
+// into one texture atlas, a row per mesh and a cell per angle. Entities past the
+// impostor distance are then drawn as one instanced quad each: the quad faces the
+// camera and samples the cell closest to the direction the camera sees the entity
+// from, so thousands of distant snowmen cost about as much as thousands of quads.
+// The quads read the view-projection from the camera block.
+
+#pragma once
+
+#define GLEW_STATIC 1
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "MeshLibrary.h"
+
+class GLStateCache;
+class StreamBuffer;
+struct StreamAllocation;
+
+
+class ImpostorRenderer
+{
+public:
+    static const int AngleCount = 8;
+    static const int CellSize = 128;        // texels per side of one view
+
+    ImpostorRenderer();
+    ~ImpostorRenderer();
+
+    // Renders the atlas with the scene shader without features; the viewport and
+    // clear color are put back afterwards
+    bool create(const MeshLibrary& meshes, GLuint sceneProgram, GLint modelViewProjectionLocation);
+    void destroy();
+
+    // Draws count CrowdImpostors written to the stream buffer, the camera block must be
+    // bound. The view picks each billboard's facing and atlas cell: quads turn around z
+    // towards the camera, except in views looking nearly along z, where they would be
+    // seen edge-on and face the screen instead.
+    void draw(GLStateCache& stateCache, StreamBuffer& streamBuffer, const StreamAllocation& impostors, GLsizei count,
+              const glm::mat4& viewMatrix);
+
+    bool isCreated() const { return mAtlas != 0; }
+
+private:
+    GLuint mProgram;
+    GLint mCameraPositionLocation;
+    GLint mScreenRightLocation;
+    GLint mScreenUpLocation;
+    GLint mAtlasCellsLocation;
+    GLuint mVertexArray;
+    GLuint mAtlas;
+};
@@ -0,0 +1,147 @@
+//
+// COMP 371 Labs Framework
+//
+// Job system -- COMP371 Assignment 2
+
+#include "JobSystem.h"
+#include "AllocationTracker.h"
+#include "FrameArena.h"
+
+
+JobSystem::JobSystem()
+    : mHead(0)
+    , mCount(0)
+    , mStopping(false)
+    , mFrame(0)
+{
+}
+
+
+JobSystem::~JobSystem()
+{
+    destroy();
+}
+
+
+bool JobSystem::create(int workerCount)
+{
+    if (workerCount < 0)
+    {
+        int hardwareThreads = (int)std::thread::hardware_concurrency();
+        workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+    }
+
+    mStopping = false;
+    mWorkers.reserve(workerCount);
+    for (int i = 0; i < workerCount; ++i)
+        mWorkers.push_back(std::thread(&JobSystem::workerLoop, this));
+    return true;
+}
+
+
+void JobSystem::destroy()
+{
+    while (runOne())
+        ;
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mJobAvailable.notify_all();
+
+    for (size_t i = 0; i < mWorkers.size(); ++i)
+        mWorkers[i].join();
+    mWorkers.clear();
+}
+
+
+void JobSystem::push(const Job& job)
+{
+    {
+        // without workers the job waits for the pushing thread's runOne()
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (mCount < QueueCapacity)
+        {
+            mQueue[(mHead + mCount) % QueueCapacity] = job;
+            mCount++;
+            mJobAvailable.notify_one();
+            return;
+        }
+    }
+
+    job.function(job.data, job.index);
+}
+
+
+bool JobSystem::runOne()
+{
+    Job job;
+    if (!pop(job))
+        return false;
+
+    job.function(job.data, job.index);
+    return true;
+}
+
+
+void JobSystem::beginFrame()
+{
+    mFrame.fetch_add(1);
+}
+
+
+bool JobSystem::pop(Job& job)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mCount == 0)
+        return false;
+
+    job = mQueue[mHead];
+    mHead = (mHead + 1) % QueueCapacity;
+    mCount--;
+    return true;
+}
+
+
+void JobSystem::workerLoop()
+{
+    AllocationTracker::setThreadName("job worker");
+    unsigned int frame = mFrame.load();
+    bool inFrame = false;
+
+    for (;;)
+    {
+        Job job;
+        unsigned int jobFrame;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mJobAvailable.wait(lock, [this]() { return mStopping || mCount > 0; });
+            if (mCount == 0)
+                break;
+
+            job = mQueue[mHead];
+            mHead = (mHead + 1) % QueueCapacity;
+            mCount--;
+            // read under the lock, the frame began before the job was pushed
+            jobFrame = mFrame.load();
+        }
+
+        if (jobFrame != frame)
+        {
+            // a worker cannot tell when the graph is done, so its frame lasts until its
+            // first job of the next one
+            if (inFrame)
+                AllocationTracker::endThreadFrame();
+            frameArena().reset();
+            AllocationTracker::beginThreadFrame();
+            inFrame = true;
+            frame = jobFrame;
+        }
+
+        job.function(job.data, job.index);
+    }
+
+    if (inFrame)
+        AllocationTracker::endThreadFrame();
+}
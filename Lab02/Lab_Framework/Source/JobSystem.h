@@ -0,0 +1,70 @@
+//
+// COMP 371 Labs Framework
+//
+// Job system -- COMP371 Assignment 2
+//
+// A pool of worker threads taking small jobs from one shared queue. A job is a
+// function pointer, a data pointer and an index, so queueing one never allocates;
+// the queue is a fixed ring and a push that finds it full runs the job right away
+// on the pushing thread instead. Threads waiting on jobs they queued call runOne()
+// to help rather than sleep, which is also what makes a pool of zero workers work.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+typedef void (*JobFunction)(void* data, size_t index);
+
+struct Job
+{
+    JobFunction function;
+    void* data;
+    size_t index;
+};
+
+
+class JobSystem
+{
+public:
+    static const size_t QueueCapacity = 1024;
+
+    JobSystem();
+    ~JobSystem();
+
+    // workerCount < 0 uses one worker per hardware thread besides the calling one
+    bool create(int workerCount);
+
+    // Runs what is still queued, then joins the workers
+    void destroy();
+
+    int workerCount() const { return (int)mWorkers.size(); }
+
+    void push(const Job& job);
+
+    // Takes one queued job and runs it on the calling thread, false when the queue is empty
+    bool runOne();
+
+    // Jobs pushed from now on belong to a new frame. Before the first of them a worker
+    // resets its frameArena(), everything from the last frame being finished, and
+    // brackets its frame for the AllocationTracker.
+    void beginFrame();
+
+private:
+    bool pop(Job& job);
+    void workerLoop();
+
+    std::vector<std::thread> mWorkers;
+    std::mutex mMutex;
+    std::condition_variable mJobAvailable;
+    Job mQueue[QueueCapacity];
+    size_t mHead;
+    size_t mCount;
+    bool mStopping;
+    std::atomic<unsigned int> mFrame;
+};
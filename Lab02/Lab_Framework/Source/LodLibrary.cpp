@@ -0,0 +1,97 @@
+//
+// COMP 371 Labs Framework
+//
+// LOD meshes on the GPU -- COMP371 Assignment 2
+
+#include "LodLibrary.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+using namespace glm;
+
+
+LodLibrary::LodLibrary()
+    : mChains(NULL), mVertexArray(0), mVertexBuffer(0)
+{
+    for (int mesh = 0; mesh < MESH_COUNT; ++mesh)
+        mLevelCounts[mesh] = 0;
+}
+
+
+LodLibrary::~LodLibrary()
+{
+    destroy();
+}
+
+
+bool LodLibrary::create(const LodChain* chains)
+{
+    destroy();
+
+    // every level written out triangle by triangle, once at load time
+    std::vector<MeshVertex> vertices;
+    for (int mesh = 0; mesh < MESH_COUNT; ++mesh)
+    {
+        const LodChain& chain = chains[mesh];
+        mLevelCounts[mesh] = chain.levels.size() < (size_t)MaxLevels ? (int)chain.levels.size() : MaxLevels;
+        for (int level = 0; level < mLevelCounts[mesh]; ++level)
+        {
+            const std::vector<GLuint>& indices = chain.levels[level].indices;
+            mFirst[mesh][level] = (GLint)vertices.size();
+            mCounts[mesh][level] = (GLsizei)indices.size();
+            for (size_t i = 0; i < indices.size(); ++i)
+                vertices.push_back(chain.vertices[indices[i]]);
+        }
+    }
+    if (vertices.empty())
+        return false;
+
+    glGenVertexArrays(1, &mVertexArray);
+    glBindVertexArray(mVertexArray);
+
+    glGenBuffers(1, &mVertexBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, mVertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(MeshVertex), &vertices[0], GL_STATIC_DRAW);
+
+    // same layout as the MeshLibrary, the scene shader draws both
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void*)sizeof(vec3));
+    glEnableVertexAttribArray(1);
+
+    glBindVertexArray(0);
+    mChains = chains;
+    return true;
+}
+
+
+void LodLibrary::destroy()
+{
+    if (mVertexArray != 0)
+        glDeleteVertexArrays(1, &mVertexArray);
+    if (mVertexBuffer != 0)
+        glDeleteBuffers(1, &mVertexBuffer);
+
+    mVertexArray = 0;
+    mVertexBuffer = 0;
+    mChains = NULL;
+    for (int mesh = 0; mesh < MESH_COUNT; ++mesh)
+        mLevelCounts[mesh] = 0;
+}
+
+
+bool LodLibrary::select(MeshId mesh, float distance, float pixelsPerUnit, float maxPixelError, GLint& first, GLsizei& count) const
+{
+    if (mChains == NULL || mLevelCounts[mesh] == 0)
+        return false;
+
+    int level = selectLod(mChains[mesh], distance, pixelsPerUnit, maxPixelError);
+    if (level >= mLevelCounts[mesh])
+        level = mLevelCounts[mesh] - 1;
+
+    first = mFirst[mesh][level];
+    count = mCounts[mesh][level];
+    return true;
+}
@@ -0,0 +1,46 @@
+//
+// COMP 371 Labs Framework
+//
+// LOD meshes on the GPU -- COMP371 Assignment 2
+//
+// The levels of the LOD chains the mesh simplifier builds, de-indexed into one
+// vertex buffer behind one vao like the MeshLibrary's, so drawing a level is a
+// glDrawArrays range and fits a render queue DrawCommand. select() asks
+// selectLod() for the coarsest level that still looks right at a distance.
+
+#pragma once
+
+#define GLEW_STATIC 1
+#include <GL/glew.h>
+
+#include "MeshLibrary.h"
+#include "MeshSimplifier.h"
+
+
+class LodLibrary
+{
+public:
+    static const int MaxLevels = 8;
+
+    LodLibrary();
+    ~LodLibrary();
+
+    // chains holds one chain per MeshId, meshes with an empty chain have no levels.
+    // The chains are read again by select() and have to outlive the library.
+    bool create(const LodChain* chains);
+    void destroy();
+
+    bool isCreated() const { return mVertexArray != 0; }
+    GLuint vertexArray() const { return mVertexArray; }
+
+    // The vertex range of the level of mesh to draw at distance, false when the mesh has no levels
+    bool select(MeshId mesh, float distance, float pixelsPerUnit, float maxPixelError, GLint& first, GLsizei& count) const;
+
+private:
+    const LodChain* mChains;
+    GLuint mVertexArray;
+    GLuint mVertexBuffer;
+    int mLevelCounts[MESH_COUNT];
+    GLint mFirst[MESH_COUNT][MaxLevels];
+    GLsizei mCounts[MESH_COUNT][MaxLevels];
+};
@@ -0,0 +1,328 @@
+//
+// COMP 371 Labs Framework
+//
+// Shared mesh storage -- COMP371 Assignment 2
+
+#include "MeshLibrary.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+using namespace glm;
+
+
+static const MeshVertex* getLabVertices(int& vertexCount)
+{
+    // Cube model -- taken from lab, added unit lines at bottom
+    static const vec3 vertexArray[] = {  // position,                            color
+        vec3(-0.5f,-0.5f,-0.5f), vec3(1.0f, 1.0f, 1.0f), //left
+        vec3(-0.5f,-0.5f, 0.5f), vec3(1.0f, 1.0f, 1.0f),
+        vec3(-0.5f, 0.5f, 0.5f), vec3(1.0f, 1.0f, 1.0f),
+
+        vec3(-0.5f,-0.5f,-0.5f), vec3(1.0f, 1.0f, 1.0f),
+        vec3(-0.5f, 0.5f, 0.5f), vec3(1.0f, 1.0f, 1.0f),
+        vec3(-0.5f, 0.5f,-0.5f), vec3(1.0f, 1.0f, 1.0f),
+
+        vec3(0.5f, 0.5f,-0.5f), vec3(1.0f, 1.0f, 1.0f), // far
+        vec3(-0.5f,-0.5f,-0.5f), vec3(1.0f, 1.0f, 1.0f),
+        vec3(-0.5f, 0.5f,-0.5f), vec3(1.0f, 1.0f, 1.0f),
+
+        vec3(0.5f, 0.5f,-0.5f), vec3(1.0f, 1.0f, 1.0f),
+        vec3(0.5f,-0.5f,-0.5f), vec3(1.0f, 1.0f, 1.0f),
+        vec3(-0.5f,-0.5f,-0.5f), vec3(1.0f, 1.0f, 1.0f),
+
+        vec3(0.5f,-0.5f, 0.5f), vec3(1.0f, 1.0f, 1.0f), // bottom 
+        vec3(-0.5f,-0.5f,-0.5f), vec3(1.0f, 1.0f, 1.0f),
+        vec3(0.5f,-0.5f,-0.5f), vec3(1.0f, 1.0f, 1.0f),
+
+        vec3(0.5f,-0.5f, 0.5f), vec3(1.0f, 1.0f, 1.0f),
+        vec3(-0.5f,-0.5f, 0.5f), vec3(1.0f, 1.0f, 1.0f),
+        vec3(-0.5f,-0.5f,-0.5f), vec3(1.0f, 1.0f, 1.0f),
+
+        vec3(-0.5f, 0.5f, 0.5f), vec3(1.0f, 1.0f, 1.0f), // near 
+        vec3(-0.5f,-0.5f, 0.5f), vec3(1.0f, 1.0f, 1.0f),
+        vec3(0.5f,-0.5f, 0.5f), vec3(1.0f, 1.0f, 1.0f),
+
+        vec3(0.5f, 0.5f, 0.5f), vec3(1.0f, 1.0f, 1.0f),
+        vec3(-0.5f, 0.5f, 0.5f), vec3(1.0f, 1.0f, 1.0f),
+        vec3(0.5f,-0.5f, 0.5f), vec3(1.0f, 1.0f, 1.0f),
+
+        vec3(0.5f, 0.5f, 0.5f), vec3(1.0f, 1.0f, 1.0f), // right 
+        vec3(0.5f,-0.5f,-0.5f), vec3(1.0f, 1.0f, 1.0f),
+        vec3(0.5f, 0.5f,-0.5f), vec3(1.0f, 1.0f, 1.0f),
+
+        vec3(0.5f,-0.5f,-0.5f), vec3(1.0f, 1.0f, 1.0f),
+        vec3(0.5f, 0.5f, 0.5f), vec3(1.0f, 1.0f, 1.0f),
+        vec3(0.5f,-0.5f, 0.5f), vec3(1.0f, 1.0f, 1.0f),
+
+        vec3(0.5f, 0.5f, 0.5f), vec3(1.0f, 1.0f, 1.0f), // top 
+        vec3(0.5f, 0.5f,-0.5f), vec3(1.0f, 1.0f, 1.0f),
+        vec3(-0.5f, 0.5f,-0.5f), vec3(1.0f, 1.0f, 1.0f),
+
+        vec3(0.5f, 0.5f, 0.5f), vec3(1.0f, 1.0f, 1.0f),
+        vec3(-0.5f, 0.5f,-0.5f), vec3(1.0f, 1.0f, 1.0f),
+        vec3(-0.5f, 0.5f, 0.5f), vec3(1.0f, 1.0f, 1.0f),
+
+
+        
+
+        vec3(0.0f, 0.0f, 0.0f), vec3(1.0f, 1.0f, 0.0f), // line in x
+        vec3(1.0f, 0.0f, 0.0f), vec3(1.0f, 1.0f, 0.0f),
+
+        vec3(0.0f, 0.0f, 0.0f), vec3(1.0f, 1.0f, 0.0f), // line in y
+        vec3(0.0f, 1.0f, 0.0f), vec3(1.0f, 1.0f, 0.0f),
+
+        vec3(0.0f, 0.0f, 0.0f), vec3(1.0f, 1.0f, 0.0f), // line in z
+        vec3(0.0f, 0.0f, 1.0f), vec3(1.0f, 1.0f, 0.0f),
+
+        vec3(0.0f, 0.0f, 0.0f), vec3(1.0f, 0.0f, 0.0f), // redline in x
+        vec3(1.0f, 0.0f, 0.0f), vec3(1.0f, 0.0f, 0.0f),
+
+        vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, 0.0f, 1.0f), // blueline in y
+        vec3(0.0f, 1.0f, 0.0f), vec3(0.0f, 0.0f, 1.0f),
+
+        vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f), // greenline in z
+        vec3(0.0f, 0.0f, 1.0f), vec3(0.0f, 1.0f, 0.0f),
+
+
+
+        //  BLACK FOR NOSE
+        vec3(-0.5f,-0.5f,-0.5f), vec3(0.0f, 0.0f, 0.0f), //left
+        vec3(-0.5f,-0.5f, 0.5f), vec3(0.0f, 0.0f, 0.0f),
+        vec3(-0.5f, 0.5f, 0.5f), vec3(0.0f, 0.0f, 0.0f),
+
+        vec3(-0.5f,-0.5f,-0.5f), vec3(0.0f, 0.0f, 0.0f),
+        vec3(-0.5f, 0.5f, 0.5f), vec3(0.0f, 0.0f, 0.0f),
+        vec3(-0.5f, 0.5f,-0.5f), vec3(0.0f, 0.0f, 0.0f),
+
+        vec3(0.5f, 0.5f,-0.5f), vec3(0.0f, 0.0f, 0.0f), // far
+        vec3(-0.5f,-0.5f,-0.5f), vec3(0.0f, 0.0f, 0.0f),
+        vec3(-0.5f, 0.5f,-0.5f), vec3(0.0f, 0.0f, 0.0f),
+
+        vec3(0.5f, 0.5f,-0.5f), vec3(0.0f, 0.0f, 0.0f),
+        vec3(0.5f,-0.5f,-0.5f), vec3(0.0f, 0.0f, 0.0f),
+        vec3(-0.5f,-0.5f,-0.5f), vec3(0.0f, 0.0f, 0.0f),
+
+        vec3(0.5f,-0.5f, 0.5f), vec3(0.0f, 0.0f, 0.0f), // bottom 
+        vec3(-0.5f,-0.5f,-0.5f), vec3(0.0f, 0.0f, 0.0f),
+        vec3(0.5f,-0.5f,-0.5f), vec3(0.0f, 0.0f, 0.0f),
+
+        vec3(0.5f,-0.5f, 0.5f), vec3(0.0f, 0.0f, 0.0f),
+        vec3(-0.5f,-0.5f, 0.5f), vec3(0.0f, 0.0f, 0.0f),
+        vec3(-0.5f,-0.5f,-0.5f), vec3(0.0f, 0.0f, 0.0f),
+
+        vec3(-0.5f, 0.5f, 0.5f), vec3(0.0f, 0.0f, 0.0f), // near 
+        vec3(-0.5f,-0.5f, 0.5f), vec3(0.0f, 0.0f, 0.0f),
+        vec3(0.5f,-0.5f, 0.5f), vec3(0.0f, 0.0f, 0.0f),
+
+        vec3(0.5f, 0.5f, 0.5f), vec3(0.0f, 0.0f, 0.0f),
+        vec3(-0.5f, 0.5f, 0.5f), vec3(0.0f, 0.0f, 0.0f),
+        vec3(0.5f,-0.5f, 0.5f), vec3(0.0f, 0.0f, 0.0f),
+
+        vec3(0.5f, 0.5f, 0.5f), vec3(0.0f, 0.0f, 0.0f), // right 
+        vec3(0.5f,-0.5f,-0.5f), vec3(0.0f, 0.0f, 0.0f),
+        vec3(0.5f, 0.5f,-0.5f), vec3(0.0f, 0.0f, 0.0f),
+
+        vec3(0.5f,-0.5f,-0.5f), vec3(0.0f, 0.0f, 0.0f),
+        vec3(0.5f, 0.5f, 0.5f), vec3(0.0f, 0.0f, 0.0f),
+        vec3(0.5f,-0.5f, 0.5f), vec3(0.0f, 0.0f, 0.0f),
+
+        vec3(0.5f, 0.5f, 0.5f), vec3(0.0f, 0.0f, 0.0f), // top 
+        vec3(0.5f, 0.5f,-0.5f), vec3(0.0f, 0.0f, 0.0f),
+        vec3(-0.5f, 0.5f,-0.5f), vec3(0.0f, 0.0f, 0.0f),
+
+        vec3(0.5f, 0.5f, 0.5f), vec3(0.0f, 0.0f, 0.0f),
+        vec3(-0.5f, 0.5f,-0.5f), vec3(0.0f, 0.0f, 0.0f),
+        vec3(-0.5f, 0.5f, 0.5f), vec3(0.0f, 0.0f, 0.0f),
+
+    };
+
+    vertexCount = (int)(sizeof(vertexArray) / (2 * sizeof(vec3)));
+    return (const MeshVertex*)vertexArray;
+}
+
+
+static const MeshId sImpostorMeshes[IMPOSTOR_MESH_COUNT] = { MESH_CUBE, MESH_NOSE, MESH_SNOWMAN };
+
+
+int impostorAtlasRow(MeshId mesh)
+{
+    for (int row = 0; row < IMPOSTOR_MESH_COUNT; ++row)
+    {
+        if (sImpostorMeshes[row] == mesh)
+            return row;
+    }
+    return -1;
+}
+
+
+MeshId impostorMesh(int row)
+{
+    return sImpostorMeshes[row];
+}
+
+
+int getSnowmanPartParent(int part)
+{
+    // the nose sits on the head, everything else on the body
+    static const int parents[SNOWMAN_PART_COUNT] = { -1, SNOWMAN_BODY, SNOWMAN_BODY, SNOWMAN_HEAD };
+    return parents[part];
+}
+
+
+void getSnowmanPartLocalTransforms(mat4 locals[SNOWMAN_PART_COUNT])
+{
+    // same chain the main loop used on olafWorldMatrix
+    locals[SNOWMAN_BODY] = mat4(1.0f);
+    locals[SNOWMAN_TORSO] = translate(mat4(1.0f), vec3(0.05f, 0.05f, 0.75f)) * scale(mat4(1.0), vec3(0.6f, 0.6f, 0.6f));
+    locals[SNOWMAN_HEAD] = translate(mat4(1.0f), vec3(0.05f, 0.05f, 1.2f)) * scale(mat4(1.0), vec3(0.3f, 0.3f, 0.3f));
+    locals[SNOWMAN_NOSE] = translate(mat4(1.0f), vec3(0.4f, 0.0f, 0.15f)) * scale(mat4(1.0), vec3(0.8f, 0.4f, 0.4f));
+}
+
+
+void getSnowmanPartTransforms(mat4 parts[SNOWMAN_PART_COUNT])
+{
+    getSnowmanPartLocalTransforms(parts);
+
+    // parents come before their children
+    for (int part = 0; part < SNOWMAN_PART_COUNT; ++part)
+    {
+        int parent = getSnowmanPartParent(part);
+        if (parent >= 0)
+            parts[part] = parts[parent] * parts[part];
+    }
+}
+
+
+MeshLibrary::MeshLibrary()
+    : mVertexArray(0), mVertexBuffer(0), mIndexBuffer(0)
+{
+}
+
+
+MeshLibrary::~MeshLibrary()
+{
+    destroy();
+}
+
+
+void MeshLibrary::addMesh(MeshId id, GLenum mode, GLint baseVertex, GLsizei vertexCount)
+{
+    Mesh& mesh = mMeshes[id];
+    mesh.mode = mode;
+    mesh.baseVertex = baseVertex;
+    mesh.vertexCount = vertexCount;
+    mesh.firstIndex = (GLuint)mIndices.size();
+    mesh.indexCount = vertexCount;
+
+    // indices are relative to baseVertex
+    for (GLsizei i = 0; i < vertexCount; ++i)
+        mIndices.push_back((GLuint)i);
+
+    vec3 minimum = mVertices[baseVertex].position;
+    vec3 maximum = minimum;
+    for (GLsizei i = 1; i < vertexCount; ++i)
+    {
+        minimum = min(minimum, mVertices[baseVertex + i].position);
+        maximum = max(maximum, mVertices[baseVertex + i].position);
+    }
+
+    mesh.boundsCenter = (minimum + maximum) * 0.5f;
+    mesh.boundsRadius = 0.0f;
+    for (GLsizei i = 0; i < vertexCount; ++i)
+        mesh.boundsRadius = max(mesh.boundsRadius, length(mVertices[baseVertex + i].position - mesh.boundsCenter));
+}
+
+
+bool MeshLibrary::create()
+{
+    destroy();
+
+    int labVertexCount = 0;
+    const MeshVertex* labVertices = getLabVertices(labVertexCount);
+    mVertices.assign(labVertices, labVertices + labVertexCount);
+
+    addMesh(MESH_CUBE, GL_TRIANGLES, 0, 36);
+    addMesh(MESH_GRID_LINE_X, GL_LINES, 36, 2);
+    addMesh(MESH_GRID_LINE_Y, GL_LINES, 38, 2);
+    addMesh(MESH_GRID_LINE_Z, GL_LINES, 40, 2);
+    addMesh(MESH_AXIS_X, GL_LINES, 42, 2);
+    addMesh(MESH_AXIS_Y, GL_LINES, 44, 2);
+    addMesh(MESH_AXIS_Z, GL_LINES, 46, 2);
+    addMesh(MESH_NOSE, GL_TRIANGLES, 48, 36);
+
+    // Bake the four parts into one mesh so a whole snowman is a single instance
+    mat4 parts[SNOWMAN_PART_COUNT];
+    getSnowmanPartTransforms(parts);
+
+    GLint snowmanBase = (GLint)mVertices.size();
+    for (int part = 0; part < SNOWMAN_PART_COUNT; ++part)
+    {
+        const Mesh& source = mMeshes[part == SNOWMAN_NOSE ? MESH_NOSE : MESH_CUBE];
+        for (GLsizei i = 0; i < source.vertexCount; ++i)
+        {
+            MeshVertex vertex = mVertices[source.baseVertex + i];
+            vertex.position = vec3(parts[part] * vec4(vertex.position, 1.0f));
+            mVertices.push_back(vertex);
+        }
+    }
+    addMesh(MESH_SNOWMAN, GL_TRIANGLES, snowmanBase, (GLsizei)mVertices.size() - snowmanBase);
+
+    // Create a vertex array -- taken from lab
+    glGenVertexArrays(1, &mVertexArray);
+    glBindVertexArray(mVertexArray);
+
+    glGenBuffers(1, &mVertexBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, mVertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, mVertices.size() * sizeof(MeshVertex), &mVertices[0], GL_STATIC_DRAW);
+
+    glGenBuffers(1, &mIndexBuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mIndexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, mIndices.size() * sizeof(GLuint), &mIndices[0], GL_STATIC_DRAW);
+
+    setupVertexAttributes();
+
+    glBindVertexArray(0);
+    return true;
+}
+
+
+void MeshLibrary::setupVertexAttributes() const
+{
+    glBindBuffer(GL_ARRAY_BUFFER, mVertexBuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mIndexBuffer);
+
+    glVertexAttribPointer(0,                   // attribute 0 matches aPos in Vertex Shader
+        3,                   // size
+        GL_FLOAT,            // type
+        GL_FALSE,            // normalized?
+        sizeof(MeshVertex),  // stride - each vertex contain 2 vec3 (position, color)
+        (void*)0             // array buffer offset
+    );
+    glEnableVertexAttribArray(0);
+
+    glVertexAttribPointer(1,                            // attribute 1 matches aColor in Vertex Shader
+        3,
+        GL_FLOAT,
+        GL_FALSE,
+        sizeof(MeshVertex),
+        (void*)sizeof(vec3)      // color is offseted a vec3 (comes after position)
+    );
+    glEnableVertexAttribArray(1);
+}
+
+
+void MeshLibrary::destroy()
+{
+    if (mVertexArray != 0)
+        glDeleteVertexArrays(1, &mVertexArray);
+    if (mVertexBuffer != 0)
+        glDeleteBuffers(1, &mVertexBuffer);
+    if (mIndexBuffer != 0)
+        glDeleteBuffers(1, &mIndexBuffer);
+
+    mVertexArray = 0;
+    mVertexBuffer = 0;
+    mIndexBuffer = 0;
+    mVertices.clear();
+    mIndices.clear();
+}
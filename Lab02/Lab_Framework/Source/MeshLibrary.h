@@ -0,0 +1,120 @@
+//
+// COMP 371 Labs Framework
+//
+// Shared mesh storage -- COMP371 Assignment 2
+//
+// Every mesh lives in one vertex buffer and one index buffer behind a single vao.
+// Vertex ranges of the original lab model are kept as they were, so the cube is
+// still vertices 0-35, the grid lines 36-41, the axes 42-47 and the nose 48-83.
+// The index buffer is one index per vertex for now, which lets the same ranges be
+// drawn with glDrawArrays or as indexed/indirect draws.
+
+#pragma once
+
+#define GLEW_STATIC 1
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+
+enum MeshId
+{
+    MESH_CUBE = 0,      // white unit cube
+    MESH_GRID_LINE_X,   // yellow unit lines
+    MESH_GRID_LINE_Y,
+    MESH_GRID_LINE_Z,
+    MESH_AXIS_X,        // red / blue / green unit lines
+    MESH_AXIS_Y,
+    MESH_AXIS_Z,
+    MESH_NOSE,          // black unit cube
+    MESH_SNOWMAN,       // all four parts baked in the snowman's root space
+
+    MESH_COUNT
+};
+
+
+enum SnowmanPart
+{
+    SNOWMAN_BODY = 0,
+    SNOWMAN_TORSO,
+    SNOWMAN_HEAD,
+    SNOWMAN_NOSE,
+
+    SNOWMAN_PART_COUNT
+};
+
+
+struct MeshVertex
+{
+    glm::vec3 position;
+    glm::vec3 color;
+};
+
+
+struct Mesh
+{
+    GLenum mode;
+    GLint baseVertex;
+    GLsizei vertexCount;
+    GLuint firstIndex;
+    GLsizei indexCount;
+
+    // bounding sphere in the mesh's own space
+    glm::vec3 boundsCenter;
+    float boundsRadius;
+};
+
+
+class MeshLibrary
+{
+public:
+    MeshLibrary();
+    ~MeshLibrary();
+
+    bool create();
+    void destroy();
+
+    // Points attributes 0 (position) and 1 (color) of the currently bound vao at the shared buffers
+    void setupVertexAttributes() const;
+
+    GLuint vertexArray() const { return mVertexArray; }
+    GLuint vertexBuffer() const { return mVertexBuffer; }
+    GLuint indexBuffer() const { return mIndexBuffer; }
+
+    const Mesh& mesh(MeshId id) const { return mMeshes[id]; }
+
+    // CPU copies of the buffers
+    const std::vector<MeshVertex>& vertices() const { return mVertices; }
+    const std::vector<GLuint>& indices() const { return mIndices; }
+
+private:
+    void addMesh(MeshId id, GLenum mode, GLint baseVertex, GLsizei vertexCount);
+
+    GLuint mVertexArray;
+    GLuint mVertexBuffer;
+    GLuint mIndexBuffer;
+    Mesh mMeshes[MESH_COUNT];
+    std::vector<MeshVertex> mVertices;
+    std::vector<GLuint> mIndices;
+};
+
+
+// Triangle meshes that get a row in the impostor atlas, the lines do not
+static const int IMPOSTOR_MESH_COUNT = 3;
+
+// Atlas row of a mesh, -1 for meshes without an impostor
+int impostorAtlasRow(MeshId mesh);
+
+// Mesh drawn into an atlas row
+MeshId impostorMesh(int row);
+
+// Part each snowman part hangs from, -1 for the body
+int getSnowmanPartParent(int part);
+
+// Transforms of olaf's parts relative to their parent part
+void getSnowmanPartLocalTransforms(glm::mat4 locals[SNOWMAN_PART_COUNT]);
+
+// Transforms of olaf's parts relative to the snowman's root (the body)
+void getSnowmanPartTransforms(glm::mat4 parts[SNOWMAN_PART_COUNT]);
@@ -0,0 +1,696 @@
+//
+// COMP 371 Labs Framework
+//
+// Mesh simplification -- COMP371 Assignment 2
+
+#include "MeshSimplifier.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <map>
+#include <queue>
+#include <thread>
+#include <utility>
+
+using namespace glm;
+
+
+// Symmetric 4x4 matrix as its upper triangle: a00 a01 a02 a03 a11 a12 a13 a22 a23 a33
+struct Quadric
+{
+    double a[10];
+};
+
+
+static Quadric zeroQuadric()
+{
+    Quadric q;
+    for (int i = 0; i < 10; ++i)
+        q.a[i] = 0.0;
+    return q;
+}
+
+
+// Squared distance to the plane n.p + d = 0 (n normalized), times weight
+static Quadric planeQuadric(const dvec3& n, double d, double weight)
+{
+    Quadric q;
+    q.a[0] = n.x * n.x * weight; q.a[1] = n.x * n.y * weight; q.a[2] = n.x * n.z * weight; q.a[3] = n.x * d * weight;
+    q.a[4] = n.y * n.y * weight; q.a[5] = n.y * n.z * weight; q.a[6] = n.y * d * weight;
+    q.a[7] = n.z * n.z * weight; q.a[8] = n.z * d * weight;
+    q.a[9] = d * d * weight;
+    return q;
+}
+
+
+static void addQuadric(Quadric& q, const Quadric& other)
+{
+    for (int i = 0; i < 10; ++i)
+        q.a[i] += other.a[i];
+}
+
+
+static double evaluateQuadric(const Quadric& q, const dvec3& p)
+{
+    return q.a[0] * p.x * p.x + 2.0 * q.a[1] * p.x * p.y + 2.0 * q.a[2] * p.x * p.z + 2.0 * q.a[3] * p.x
+         + q.a[4] * p.y * p.y + 2.0 * q.a[5] * p.y * p.z + 2.0 * q.a[6] * p.y
+         + q.a[7] * p.z * p.z + 2.0 * q.a[8] * p.z
+         + q.a[9];
+}
+
+
+// Where the gradient is zero, false when the quadric is flat in some direction
+static bool minimizeQuadric(const Quadric& q, dvec3& position)
+{
+    dmat3 m(q.a[0], q.a[1], q.a[2],
+            q.a[1], q.a[4], q.a[5],
+            q.a[2], q.a[5], q.a[7]);
+    double scale = q.a[0] + q.a[4] + q.a[7];
+    double det = determinant(m);
+    if (scale <= 0.0 || fabs(det) < 1e-9 * scale * scale * scale)
+        return false;
+
+    position = inverse(m) * -dvec3(q.a[3], q.a[6], q.a[8]);
+    return true;
+}
+
+
+// Closest point on triangle abc to p (Ericson, Real-Time Collision Detection 5.1.5)
+static dvec3 closestPointOnTriangle(const dvec3& p, const dvec3& a, const dvec3& b, const dvec3& c)
+{
+    dvec3 ab = b - a, ac = c - a, ap = p - a;
+    double d1 = dot(ab, ap), d2 = dot(ac, ap);
+    if (d1 <= 0.0 && d2 <= 0.0)
+        return a;
+
+    dvec3 bp = p - b;
+    double d3 = dot(ab, bp), d4 = dot(ac, bp);
+    if (d3 >= 0.0 && d4 <= d3)
+        return b;
+
+    double vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0)
+        return a + ab * (d1 / (d1 - d3));
+
+    dvec3 cp = p - c;
+    double d5 = dot(ab, cp), d6 = dot(ac, cp);
+    if (d6 >= 0.0 && d5 <= d6)
+        return c;
+
+    double vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0)
+        return a + ac * (d2 / (d2 - d6));
+
+    double va = d3 * d6 - d5 * d4;
+    if (va <= 0.0 && d4 - d3 >= 0.0 && d5 - d6 >= 0.0)
+        return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+    double denominator = 1.0 / (va + vb + vc);
+    return a + ab * (vb * denominator) + ac * (vc * denominator);
+}
+
+
+struct WeldKey
+{
+    vec3 position;
+    vec3 color;
+};
+
+struct WeldKeyLess
+{
+    bool operator()(const WeldKey& a, const WeldKey& b) const
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            if (a.position[i] != b.position[i])
+                return a.position[i] < b.position[i];
+        }
+        for (int i = 0; i < 3; ++i)
+        {
+            if (a.color[i] != b.color[i])
+                return a.color[i] < b.color[i];
+        }
+        return false;
+    }
+};
+
+
+class QuadricSimplifier
+{
+public:
+    QuadricSimplifier(const SimplifyInput& input, const SimplifyOptions& options);
+
+    size_t triangleCount() const { return mLiveTriangles; }
+
+    // Does the cheapest valid collapse, false when none is left
+    bool collapseNext();
+
+    // Appends the current triangles as a level, new vertex positions are added to the chain
+    void emit(LodChain& chain, float error);
+
+    // Distance between the current and the original surface, both ways
+    double measureError() const;
+
+private:
+    struct Vertex
+    {
+        dvec3 position;
+        vec3 color;
+        Quadric quadric;            // area weighted faces plus boundaries
+        unsigned int version;       // bumped when the vertex moves, stale collapses are skipped
+        bool removed;
+        std::vector<GLuint> triangles;
+        GLuint emitted;             // index in the chain of the last emitted version
+        unsigned int emittedVersion;
+    };
+
+    struct Triangle
+    {
+        GLuint v[3];
+        bool removed;
+    };
+
+    struct Collapse
+    {
+        double cost;
+        GLuint from;                // removed
+        GLuint to;                  // moved to position
+        unsigned int fromVersion;
+        unsigned int toVersion;
+        dvec3 position;
+        float t;                    // color of to blended towards from
+
+        bool operator<(const Collapse& other) const { return cost > other.cost; }
+    };
+
+    void addCollapse(GLuint a, GLuint b);
+    bool isValid(const Collapse& collapse);
+    void perform(const Collapse& collapse);
+    void gatherNeighbors(GLuint vertex, std::vector<GLuint>& neighbors) const;
+
+    SimplifyOptions mOptions;
+    std::vector<Vertex> mVertices;
+    std::vector<Triangle> mTriangles;
+    std::vector<dvec3> mOriginalPositions;
+    std::vector<Triangle> mOriginalTriangles;   // into mOriginalPositions
+    size_t mLiveTriangles;
+    std::priority_queue<Collapse> mCollapses;
+
+    // scratch
+    std::vector<GLuint> mNeighborsA;
+    std::vector<GLuint> mNeighborsB;
+};
+
+
+QuadricSimplifier::QuadricSimplifier(const SimplifyInput& input, const SimplifyOptions& options)
+    : mOptions(options), mLiveTriangles(0)
+{
+    // Weld corners that share position and color, a cube's 36 vertices become 8
+    std::map<WeldKey, GLuint, WeldKeyLess> welded;
+
+    for (size_t i = 0; i + 2 < input.indexCount; i += 3)
+    {
+        Triangle triangle;
+        triangle.removed = false;
+        for (int corner = 0; corner < 3; ++corner)
+        {
+            const MeshVertex& source = input.vertices[input.indices[i + corner]];
+            WeldKey key = { source.position, source.color };
+            auto found = welded.find(key);
+            if (found == welded.end())
+            {
+                Vertex vertex;
+                vertex.position = dvec3(source.position);
+                vertex.color = source.color;
+                vertex.quadric = zeroQuadric();
+                vertex.version = 0;
+                vertex.removed = false;
+                vertex.emitted = 0;
+                vertex.emittedVersion = ~0u;
+                found = welded.insert(std::make_pair(key, (GLuint)mVertices.size())).first;
+                mVertices.push_back(vertex);
+            }
+            triangle.v[corner] = found->second;
+        }
+
+        if (triangle.v[0] == triangle.v[1] || triangle.v[1] == triangle.v[2] || triangle.v[0] == triangle.v[2])
+            continue;
+        mTriangles.push_back(triangle);
+    }
+    mLiveTriangles = mTriangles.size();
+
+    mOriginalPositions.resize(mVertices.size());
+    for (size_t i = 0; i < mVertices.size(); ++i)
+        mOriginalPositions[i] = mVertices[i].position;
+    mOriginalTriangles = mTriangles;
+
+    // Face planes, and every edge with how many triangles use it
+    std::map<std::pair<GLuint, GLuint>, std::pair<int, GLuint>> edges;     // (count, a triangle)
+    for (GLuint t = 0; t < (GLuint)mTriangles.size(); ++t)
+    {
+        const Triangle& triangle = mTriangles[t];
+        const dvec3& p0 = mVertices[triangle.v[0]].position;
+        dvec3 normal = cross(mVertices[triangle.v[1]].position - p0, mVertices[triangle.v[2]].position - p0);
+        double area = 0.5 * length(normal);
+        if (area > 0.0)
+        {
+            normal /= 2.0 * area;
+            Quadric plane = planeQuadric(normal, -dot(normal, p0), area);
+            for (int corner = 0; corner < 3; ++corner)
+                addQuadric(mVertices[triangle.v[corner]].quadric, plane);
+        }
+
+        for (int corner = 0; corner < 3; ++corner)
+        {
+            mVertices[triangle.v[corner]].triangles.push_back(t);
+            GLuint a = triangle.v[corner];
+            GLuint b = triangle.v[(corner + 1) % 3];
+            std::pair<int, GLuint>& edge = edges[std::make_pair(std::min(a, b), std::max(a, b))];
+            edge.first++;
+            edge.second = t;
+        }
+    }
+
+    // Open and seam edges: a plane through the edge, perpendicular to its triangle
+    for (auto it = edges.begin(); it != edges.end(); ++it)
+    {
+        if (it->second.first != 1)
+            continue;
+
+        const Triangle& triangle = mTriangles[it->second.second];
+        const dvec3& p0 = mVertices[triangle.v[0]].position;
+        dvec3 faceNormal = cross(mVertices[triangle.v[1]].position - p0, mVertices[triangle.v[2]].position - p0);
+        const dvec3& a = mVertices[it->first.first].position;
+        const dvec3& b = mVertices[it->first.second].position;
+        dvec3 normal = cross(b - a, faceNormal);
+        double normalLength = length(normal);
+        if (normalLength <= 0.0)
+            continue;
+
+        normal /= normalLength;
+        Quadric boundary = planeQuadric(normal, -dot(normal, a), mOptions.boundaryWeight * dot(b - a, b - a));
+        addQuadric(mVertices[it->first.first].quadric, boundary);
+        addQuadric(mVertices[it->first.second].quadric, boundary);
+    }
+
+    for (auto it = edges.begin(); it != edges.end(); ++it)
+        addCollapse(it->first.first, it->first.second);
+}
+
+
+void QuadricSimplifier::addCollapse(GLuint a, GLuint b)
+{
+    const Vertex& va = mVertices[a];
+    const Vertex& vb = mVertices[b];
+
+    Quadric q = va.quadric;
+    addQuadric(q, vb.quadric);
+
+    // The quadric's minimum unless it is flat or far off the edge, else the best of the ends and middle
+    dvec3 midpoint = (va.position + vb.position) * 0.5;
+    double edgeLengthSquared = dot(vb.position - va.position, vb.position - va.position);
+    dvec3 position = midpoint;
+    double cost = evaluateQuadric(q, midpoint);
+    dvec3 optimal;
+    if (minimizeQuadric(q, optimal) && dot(optimal - midpoint, optimal - midpoint) <= edgeLengthSquared)
+    {
+        position = optimal;
+        cost = evaluateQuadric(q, optimal);
+    }
+    else
+    {
+        double costA = evaluateQuadric(q, va.position);
+        double costB = evaluateQuadric(q, vb.position);
+        if (costA < cost)
+        {
+            position = va.position;
+            cost = costA;
+        }
+        if (costB < cost)
+        {
+            position = vb.position;
+            cost = costB;
+        }
+    }
+
+    Collapse collapse;
+    collapse.from = b;
+    collapse.to = a;
+    collapse.fromVersion = vb.version;
+    collapse.toVersion = va.version;
+    collapse.position = position;
+    collapse.t = edgeLengthSquared > 0.0 ? (float)clamp(dot(position - va.position, vb.position - va.position) / edgeLengthSquared, 0.0, 1.0) : 0.5f;
+
+    // the color difference is paid over the edge's length squared, in the quadric's units
+    vec3 colorDifference = va.color - vb.color;
+    collapse.cost = std::max(cost, 0.0) + mOptions.colorWeight * dot(colorDifference, colorDifference) * edgeLengthSquared;
+
+    mCollapses.push(collapse);
+}
+
+
+void QuadricSimplifier::gatherNeighbors(GLuint vertex, std::vector<GLuint>& neighbors) const
+{
+    neighbors.clear();
+    const std::vector<GLuint>& triangles = mVertices[vertex].triangles;
+    for (size_t i = 0; i < triangles.size(); ++i)
+    {
+        const Triangle& triangle = mTriangles[triangles[i]];
+        if (triangle.removed)
+            continue;
+        for (int corner = 0; corner < 3; ++corner)
+        {
+            if (triangle.v[corner] != vertex)
+                neighbors.push_back(triangle.v[corner]);
+        }
+    }
+    std::sort(neighbors.begin(), neighbors.end());
+    neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+}
+
+
+bool QuadricSimplifier::isValid(const Collapse& collapse)
+{
+    // Link condition: the ends may only share the vertices opposite the edge,
+    // anything more and the collapse pinches the surface
+    gatherNeighbors(collapse.from, mNeighborsA);
+    gatherNeighbors(collapse.to, mNeighborsB);
+    size_t common = 0;
+    for (size_t i = 0, j = 0; i < mNeighborsA.size() && j < mNeighborsB.size();)
+    {
+        if (mNeighborsA[i] < mNeighborsB[j])
+            ++i;
+        else if (mNeighborsB[j] < mNeighborsA[i])
+            ++j;
+        else
+        {
+            ++common;
+            ++i;
+            ++j;
+        }
+    }
+
+    size_t shared = 0;
+    const std::vector<GLuint>& fromTriangles = mVertices[collapse.from].triangles;
+    for (size_t i = 0; i < fromTriangles.size(); ++i)
+    {
+        const Triangle& triangle = mTriangles[fromTriangles[i]];
+        if (!triangle.removed && (triangle.v[0] == collapse.to || triangle.v[1] == collapse.to || triangle.v[2] == collapse.to))
+            ++shared;
+    }
+    if (shared == 0 || common != shared)
+        return false;
+
+    // No surviving triangle may turn over
+    for (int end = 0; end < 2; ++end)
+    {
+        const std::vector<GLuint>& triangles = mVertices[end == 0 ? collapse.from : collapse.to].triangles;
+        for (size_t i = 0; i < triangles.size(); ++i)
+        {
+            const Triangle& triangle = mTriangles[triangles[i]];
+            if (triangle.removed)
+                continue;
+
+            dvec3 before[3];
+            dvec3 after[3];
+            bool hasFrom = false;
+            bool hasTo = false;
+            for (int corner = 0; corner < 3; ++corner)
+            {
+                GLuint v = triangle.v[corner];
+                hasFrom = hasFrom || v == collapse.from;
+                hasTo = hasTo || v == collapse.to;
+                before[corner] = mVertices[v].position;
+                after[corner] = v == collapse.from || v == collapse.to ? collapse.position : before[corner];
+            }
+            if (hasFrom && hasTo)
+                continue;
+
+            dvec3 normalBefore = cross(before[1] - before[0], before[2] - before[0]);
+            dvec3 normalAfter = cross(after[1] - after[0], after[2] - after[0]);
+            if (dot(normalBefore, normalAfter) <= 1e-3 * dot(normalBefore, normalBefore))
+                return false;
+        }
+    }
+    return true;
+}
+
+
+void QuadricSimplifier::perform(const Collapse& collapse)
+{
+    Vertex& from = mVertices[collapse.from];
+    Vertex& to = mVertices[collapse.to];
+
+    to.position = collapse.position;
+    to.color = mix(to.color, from.color, collapse.t);
+    addQuadric(to.quadric, from.quadric);
+    to.version++;
+    from.removed = true;
+
+    for (size_t i = 0; i < from.triangles.size(); ++i)
+    {
+        Triangle& triangle = mTriangles[from.triangles[i]];
+        if (triangle.removed)
+            continue;
+
+        if (triangle.v[0] == collapse.to || triangle.v[1] == collapse.to || triangle.v[2] == collapse.to)
+        {
+            triangle.removed = true;
+            mLiveTriangles--;
+            continue;
+        }
+        for (int corner = 0; corner < 3; ++corner)
+        {
+            if (triangle.v[corner] == collapse.from)
+                triangle.v[corner] = collapse.to;
+        }
+        to.triangles.push_back(from.triangles[i]);
+    }
+    from.triangles.clear();
+
+    // Drop the dead triangles, then queue the edges around the moved vertex again
+    std::vector<GLuint>& triangles = to.triangles;
+    size_t kept = 0;
+    for (size_t i = 0; i < triangles.size(); ++i)
+    {
+        if (!mTriangles[triangles[i]].removed)
+            triangles[kept++] = triangles[i];
+    }
+    triangles.resize(kept);
+
+    gatherNeighbors(collapse.to, mNeighborsA);
+    for (size_t i = 0; i < mNeighborsA.size(); ++i)
+        addCollapse(collapse.to, mNeighborsA[i]);
+}
+
+
+bool QuadricSimplifier::collapseNext()
+{
+    while (!mCollapses.empty())
+    {
+        Collapse collapse = mCollapses.top();
+        mCollapses.pop();
+
+        const Vertex& from = mVertices[collapse.from];
+        const Vertex& to = mVertices[collapse.to];
+        if (from.removed || to.removed || from.version != collapse.fromVersion || to.version != collapse.toVersion)
+            continue;
+        if (!isValid(collapse))
+            continue;
+
+        perform(collapse);
+        return true;
+    }
+    return false;
+}
+
+
+void QuadricSimplifier::emit(LodChain& chain, float error)
+{
+    MeshLod level;
+    level.triangleCount = 0;
+    level.error = error;
+    for (size_t t = 0; t < mTriangles.size(); ++t)
+    {
+        const Triangle& triangle = mTriangles[t];
+        if (triangle.removed)
+            continue;
+
+        for (int corner = 0; corner < 3; ++corner)
+        {
+            Vertex& vertex = mVertices[triangle.v[corner]];
+            if (vertex.emittedVersion != vertex.version)
+            {
+                MeshVertex output;
+                output.position = vec3(vertex.position);
+                output.color = vertex.color;
+                vertex.emitted = (GLuint)chain.vertices.size();
+                vertex.emittedVersion = vertex.version;
+                chain.vertices.push_back(output);
+            }
+            level.indices.push_back(vertex.emitted);
+        }
+        level.triangleCount++;
+    }
+    chain.levels.push_back(level);
+}
+
+
+double QuadricSimplifier::measureError() const
+{
+    // Brute force over every pair, this runs once per level at load time.
+    // Original vertices against the current surface catch details that were flattened away
+    double worst = 0.0;
+    for (size_t v = 0; v < mOriginalPositions.size(); ++v)
+    {
+        const dvec3& p = mOriginalPositions[v];
+        double nearest = -1.0;
+        for (size_t t = 0; t < mTriangles.size() && nearest != 0.0; ++t)
+        {
+            const Triangle& triangle = mTriangles[t];
+            if (triangle.removed)
+                continue;
+
+            dvec3 closest = closestPointOnTriangle(p, mVertices[triangle.v[0]].position, mVertices[triangle.v[1]].position, mVertices[triangle.v[2]].position);
+            double distance = dot(p - closest, p - closest);
+            if (nearest < 0.0 || distance < nearest)
+                nearest = distance;
+        }
+        worst = std::max(worst, nearest);
+    }
+
+    // and a grid of points on every current triangle against the original surface catch
+    // the ones that bulge out of it, which no original vertex sees
+    const int steps = 4;
+    for (size_t t = 0; t < mTriangles.size(); ++t)
+    {
+        const Triangle& triangle = mTriangles[t];
+        if (triangle.removed)
+            continue;
+
+        const dvec3& a = mVertices[triangle.v[0]].position;
+        const dvec3& b = mVertices[triangle.v[1]].position;
+        const dvec3& c = mVertices[triangle.v[2]].position;
+        for (int i = 0; i <= steps; ++i)
+        {
+            for (int j = 0; j <= steps - i; ++j)
+            {
+                dvec3 p = a + (b - a) * ((double)i / steps) + (c - a) * ((double)j / steps);
+                double nearest = -1.0;
+                for (size_t o = 0; o < mOriginalTriangles.size() && nearest != 0.0; ++o)
+                {
+                    const Triangle& original = mOriginalTriangles[o];
+                    dvec3 closest = closestPointOnTriangle(p, mOriginalPositions[original.v[0]], mOriginalPositions[original.v[1]],
+                                                           mOriginalPositions[original.v[2]]);
+                    double distance = dot(p - closest, p - closest);
+                    if (nearest < 0.0 || distance < nearest)
+                        nearest = distance;
+                }
+                worst = std::max(worst, nearest);
+            }
+        }
+    }
+    return sqrt(worst);
+}
+
+
+SimplifyOptions defaultSimplifyOptions()
+{
+    SimplifyOptions options;
+    options.colorWeight = 1.0f;
+    options.boundaryWeight = 10.0f;
+    return options;
+}
+
+
+void simplifyMesh(const SimplifyInput& input, const size_t* targetTriangleCounts, size_t targetCount,
+                  const SimplifyOptions& options, LodChain& chain)
+{
+    chain.vertices.clear();
+    chain.levels.clear();
+
+    QuadricSimplifier simplifier(input, options);
+    simplifier.emit(chain, 0.0f);
+
+    // errors never shrink along the chain, selectLod() relies on it
+    for (size_t i = 0; i < targetCount; ++i)
+    {
+        bool exhausted = false;
+        while (simplifier.triangleCount() > targetTriangleCounts[i])
+        {
+            if (!simplifier.collapseNext())
+            {
+                exhausted = true;
+                break;
+            }
+        }
+
+        if (simplifier.triangleCount() < chain.levels.back().triangleCount)
+            simplifier.emit(chain, std::max(chain.levels.back().error, (float)simplifier.measureError()));
+        if (exhausted)
+            break;
+    }
+}
+
+
+struct SimplifyBatch
+{
+    const SimplifyInput* inputs;
+    const size_t* targetTriangleCounts;
+    size_t targetCount;
+    SimplifyOptions options;
+    LodChain* chains;
+    std::atomic<size_t> remaining;
+};
+
+
+static void simplifyJob(void* data, size_t index)
+{
+    SimplifyBatch& batch = *(SimplifyBatch*)data;
+    simplifyMesh(batch.inputs[index], batch.targetTriangleCounts, batch.targetCount, batch.options, batch.chains[index]);
+    batch.remaining.fetch_sub(1, std::memory_order_release);
+}
+
+
+void simplifyMeshes(JobSystem& jobs, const SimplifyInput* inputs, size_t count, const size_t* targetTriangleCounts, size_t targetCount,
+                    const SimplifyOptions& options, LodChain* chains)
+{
+    SimplifyBatch batch;
+    batch.inputs = inputs;
+    batch.targetTriangleCounts = targetTriangleCounts;
+    batch.targetCount = targetCount;
+    batch.options = options;
+    batch.chains = chains;
+    batch.remaining.store(count);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        Job job = { &simplifyJob, &batch, i };
+        jobs.push(job);
+    }
+
+    while (batch.remaining.load(std::memory_order_acquire) > 0)
+    {
+        if (!jobs.runOne())
+            std::this_thread::yield();
+    }
+}
+
+
+int selectLod(const LodChain& chain, float distance, float pixelsPerUnit, float maxPixelError)
+{
+    if (distance <= 0.0f)
+        return 0;
+
+    // errors grow along the chain, stop at the first level that shows
+    int level = 0;
+    for (size_t i = 1; i < chain.levels.size(); ++i)
+    {
+        if (chain.levels[i].error * pixelsPerUnit / distance > maxPixelError)
+            break;
+        level = (int)i;
+    }
+    return level;
+}
@@ -0,0 +1,80 @@
+//
+// COMP 371 Labs Framework
+//
+// Mesh simplification -- COMP371 Assignment 2
+//
+// Builds LOD chains out of indexed triangle meshes with quadric error metrics
+// (Garland and Heckbert). Vertices with the same position and color are welded
+// first, every vertex gets the quadric of the planes of its triangles, and edges
+// collapse cheapest first into the position that minimizes the summed quadric.
+// The cost also charges for the color difference across the edge, so color seams
+// and small colored details go last; open and seam edges get extra quadrics
+// perpendicular to their triangle so the outline holds. Collapses that would flip
+// a triangle or pinch the mesh into a non-manifold are skipped.
+//
+// A chain holds one vertex array shared by all levels and an index list per
+// level, each with how far its surface strays from the original, which is what
+// selectLod() compares against the pixel error allowed at a distance. The error is
+// measured both ways: original vertices against the level's triangles, and a grid
+// of points on the level's triangles against the original ones. Sampled, so a bound
+// for meshes as coarse as these rather than an exact Hausdorff distance.
+// Meshes are independent, so simplifyMeshes() runs one job per mesh.
+
+#pragma once
+
+#define GLEW_STATIC 1
+#include <GL/glew.h>
+
+#include <vector>
+
+#include "MeshLibrary.h"
+
+class JobSystem;
+
+
+struct SimplifyInput
+{
+    const MeshVertex* vertices;
+    const GLuint* indices;      // triangle list, relative to vertices
+    size_t indexCount;
+};
+
+
+struct MeshLod
+{
+    std::vector<GLuint> indices;    // triangle list into LodChain::vertices
+    size_t triangleCount;
+    float error;                    // two-sided distance between this level's surface and the original, in mesh units; never less than the level before
+};
+
+
+struct LodChain
+{
+    std::vector<MeshVertex> vertices;
+    std::vector<MeshLod> levels;    // levels[0] is the welded original, triangle counts go down from there
+};
+
+
+struct SimplifyOptions
+{
+    float colorWeight;              // cost of a unit color difference relative to a unit of squared distance
+    float boundaryWeight;           // how strongly open and seam edges keep their place
+};
+
+SimplifyOptions defaultSimplifyOptions();
+
+
+// Simplifies one mesh down to each target triangle count, targets in decreasing order.
+// A target the mesh cannot reach without breaking it ends the chain at the smallest
+// valid level.
+void simplifyMesh(const SimplifyInput& input, const size_t* targetTriangleCounts, size_t targetCount,
+                  const SimplifyOptions& options, LodChain& chain);
+
+// One job per mesh on the job system, returns when every chain is done. The calling
+// thread runs jobs too.
+void simplifyMeshes(JobSystem& jobs, const SimplifyInput* inputs, size_t count, const size_t* targetTriangleCounts, size_t targetCount,
+                    const SimplifyOptions& options, LodChain* chains);
+
+// The coarsest level whose error stays under maxPixelError on screen. pixelsPerUnit
+// is the projection's scale at distance 1: viewport height / (2 tan(fov / 2)).
+int selectLod(const LodChain& chain, float distance, float pixelsPerUnit, float maxPixelError);
@@ -0,0 +1,226 @@
+//
+// COMP 371 Labs Framework
+//
+// Minimap -- COMP371 Assignment 2
+
+#include "Minimap.h"
+#include "Frustum.h"
+#include "GLStats.h"
+#include "RenderQueue.h"
+#include "Shaders.h"
+#include "StaticBatch.h"
+#include "StreamBuffer.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cstring>
+#include <iostream>
+
+using namespace glm;
+
+
+static const char* getCompositeVertexShaderSource()
+{
+    // a quad over the whole viewport from the vertex id, no buffers
+    return
+        "#version 330 core\n"
+        "out vec2 texCoord;\n"
+        "void main()\n"
+        "{\n"
+        "   texCoord = vec2(gl_VertexID & 1, gl_VertexID >> 1);\n"
+        "   gl_Position = vec4(texCoord * 2.0 - 1.0, 0.0, 1.0);\n"
+        "}\n";
+}
+
+
+static const char* getCompositeFragmentShaderSource()
+{
+    return
+        "#version 330 core\n"
+        "uniform sampler2D minimap;\n"
+        "in vec2 texCoord;\n"
+        "out vec4 FragColor;\n"
+        "void main()\n"
+        "{\n"
+        "   FragColor = vec4(texture(minimap, texCoord).rgb, 1.0);\n"
+        "}\n";
+}
+
+
+static bool createColorTarget(GLuint& texture, GLuint& framebuffer)
+{
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, Minimap::Resolution, Minimap::Resolution, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return complete;
+}
+
+
+Minimap::Minimap()
+    : mMarkerProgram(0), mModelViewProjectionLocation(-1), mMarkerVertexArray(0), mCompositeProgram(0), mQuadVertexArray(0),
+      mStaticTexture(0), mStaticFramebuffer(0), mTexture(0), mFramebuffer(0),
+      mViewProjection(1.0f), mSceneClearColor(0.0f), mStaticLayerValid(false), mHasContents(false), mUpdateCount(0)
+{
+}
+
+
+Minimap::~Minimap()
+{
+    destroy();
+}
+
+
+bool Minimap::create(GLuint markerProgram, GLint modelViewProjectionLocation, GLuint streamBufferObject)
+{
+    mMarkerProgram = markerProgram;
+    mModelViewProjectionLocation = modelViewProjectionLocation;
+
+    mCompositeProgram = linkProgram(compileShader(GL_VERTEX_SHADER, getCompositeVertexShaderSource()),
+                                    compileShader(GL_FRAGMENT_SHADER, getCompositeFragmentShaderSource()));
+    if (mCompositeProgram == 0)
+    {
+        std::cerr << "Minimap: composite shader failed" << std::endl;
+        return false;
+    }
+
+    if (!createColorTarget(mStaticTexture, mStaticFramebuffer) || !createColorTarget(mTexture, mFramebuffer))
+    {
+        std::cerr << "Minimap: framebuffer is incomplete" << std::endl;
+        destroy();
+        return false;
+    }
+
+    // Markers are written to the stream buffer on each update, offsets are set when drawing
+    glGenVertexArrays(1, &mMarkerVertexArray);
+    glBindVertexArray(mMarkerVertexArray);
+    glBindBuffer(GL_ARRAY_BUFFER, streamBufferObject);
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glBindVertexArray(0);
+
+    // core profile wants a vertex array bound even when the quad comes from gl_VertexID
+    glGenVertexArrays(1, &mQuadVertexArray);
+
+    // Looking straight down at the ground, a little margin around the 100 units
+    mViewProjection = ortho(-55.0f, 55.0f, -55.0f, 55.0f, 1.0f, 150.0f)
+                    * lookAt(vec3(0.0f, 0.0f, 60.0f), vec3(0.0f), vec3(0.0f, 1.0f, 0.0f));
+
+    // the maps clear to their own color, the scene's is put back afterwards
+    glGetFloatv(GL_COLOR_CLEAR_VALUE, &mSceneClearColor[0]);
+
+    mStaticLayerValid = false;
+    mHasContents = false;
+    mUpdateCount = 0;
+    return true;
+}
+
+
+void Minimap::destroy()
+{
+    if (mFramebuffer != 0)
+        glDeleteFramebuffers(1, &mFramebuffer);
+    if (mStaticFramebuffer != 0)
+        glDeleteFramebuffers(1, &mStaticFramebuffer);
+    if (mTexture != 0)
+        glDeleteTextures(1, &mTexture);
+    if (mStaticTexture != 0)
+        glDeleteTextures(1, &mStaticTexture);
+    if (mMarkerVertexArray != 0)
+        glDeleteVertexArrays(1, &mMarkerVertexArray);
+    if (mQuadVertexArray != 0)
+        glDeleteVertexArrays(1, &mQuadVertexArray);
+    if (mCompositeProgram != 0)
+        glDeleteProgram(mCompositeProgram);
+
+    mFramebuffer = mStaticFramebuffer = 0;
+    mTexture = mStaticTexture = 0;
+    mMarkerVertexArray = mQuadVertexArray = 0;
+    mCompositeProgram = 0;
+}
+
+
+void Minimap::update(GLStateCache& stateCache, StreamBuffer& streamBuffer, StaticBatch& staticLayer,
+                     const MinimapMarker* markers, size_t markerCount, GLint viewportX, GLint viewportY, GLsizei viewportWidth, GLsizei viewportHeight)
+{
+    if (mFramebuffer == 0)
+        return;
+
+    glViewport(0, 0, Resolution, Resolution);
+
+    if (!mStaticLayerValid)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, mStaticFramebuffer);
+        glClearColor(0.0f, 0.1f, 0.05f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glClearColor(mSceneClearColor.r, mSceneClearColor.g, mSceneClearColor.b, mSceneClearColor.a);
+        staticLayer.render(stateCache, mViewProjection, extractFrustum(mViewProjection));
+        mStaticLayerValid = true;
+    }
+
+    // Start from the cached layer, a copy of 64 KB instead of a few hundred draws
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, mStaticFramebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, mFramebuffer);
+    glBlitFramebuffer(0, 0, Resolution, Resolution, 0, 0, Resolution, Resolution, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
+
+    if (markerCount > 0)
+    {
+        StreamAllocation points = streamBuffer.allocate(markerCount * sizeof(MinimapMarker), sizeof(vec3));
+        if (points.data != NULL)
+        {
+            memcpy(points.data, markers, points.size);
+            streamBuffer.flush();
+
+            stateCache.useProgram(mMarkerProgram);
+            stateCache.setRenderState(0);
+            stateCache.uniformMatrix4(mModelViewProjectionLocation, mViewProjection);
+            stateCache.bindVertexArray(mMarkerVertexArray);
+            statsBindBuffer(GL_ARRAY_BUFFER, streamBuffer.buffer());
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(MinimapMarker), (void*)points.offset);
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(MinimapMarker), (void*)(points.offset + sizeof(vec3)));
+            glPointSize(2.0f);
+            statsDrawArrays(GL_POINTS, 0, (GLsizei)markerCount);
+            glPointSize(1.0f);
+        }
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(viewportX, viewportY, viewportWidth, viewportHeight);
+    mHasContents = true;
+    mUpdateCount++;
+}
+
+
+void Minimap::composite(GLStateCache& stateCache, GLint viewportX, GLint viewportY, GLsizei viewportWidth, GLsizei viewportHeight)
+{
+    if (!mHasContents)
+        return;
+
+    const GLsizei size = 2 * Resolution;
+    const GLint margin = 10;
+    if (viewportWidth < size + 2 * margin || viewportHeight < size + 2 * margin)
+        return;
+
+    glViewport(viewportX + viewportWidth - size - margin, viewportY + viewportHeight - size - margin, size, size);
+
+    stateCache.useProgram(mCompositeProgram);
+    stateCache.setRenderState(0);
+    stateCache.bindVertexArray(mQuadVertexArray);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, mTexture);
+    statsDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glViewport(viewportX, viewportY, viewportWidth, viewportHeight);
+}
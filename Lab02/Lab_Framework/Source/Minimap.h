@@ -0,0 +1,78 @@
+//
+// COMP 371 Labs Framework
+//
+// Minimap -- COMP371 Assignment 2
+//
+// Top-down overview of the 100x100 ground in a corner of the main view. It lives
+// in a small texture instead of being a second camera over the whole scene: the
+// static layer (the static batch: floor grid and axes) is drawn into a texture of its own once, and an
+// update only copies that layer and draws the entity markers over it as points.
+// Updates come from the packets that carry new markers, which the simulation sends
+// at a reduced rate; every other frame just composites the last result as a quad.
+
+#pragma once
+
+#define GLEW_STATIC 1
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+class GLStateCache;
+class StaticBatch;
+class StreamBuffer;
+
+
+// One point on the map, position and color pairs like the main vertex array
+struct MinimapMarker
+{
+    glm::vec3 position;     // world space, only x and y matter
+    glm::vec3 color;
+};
+
+
+class Minimap
+{
+public:
+    static const int Resolution = 128;      // texels per side, shown at twice the size
+
+    Minimap();
+    ~Minimap();
+
+    // markerProgram is the scene shader without features, markers are streamed
+    // from streamBufferObject
+    bool create(GLuint markerProgram, GLint modelViewProjectionLocation, GLuint streamBufferObject);
+    void destroy();
+
+    // The static layer is drawn again on the next update
+    void invalidateStaticLayer() { mStaticLayerValid = false; }
+
+    // Redraws the map from the cached static layer and the markers; staticLayer is only
+    // rendered when the cache is invalid. Leaves the default framebuffer bound with the
+    // given viewport.
+    void update(GLStateCache& stateCache, StreamBuffer& streamBuffer, StaticBatch& staticLayer,
+                const MinimapMarker* markers, size_t markerCount, GLint viewportX, GLint viewportY, GLsizei viewportWidth, GLsizei viewportHeight);
+
+    // Draws the last update into the top right corner of the viewport, over everything
+    void composite(GLStateCache& stateCache, GLint viewportX, GLint viewportY, GLsizei viewportWidth, GLsizei viewportHeight);
+
+    bool isCreated() const { return mFramebuffer != 0; }
+    unsigned int updateCount() const { return mUpdateCount; }
+
+private:
+    GLuint mMarkerProgram;
+    GLint mModelViewProjectionLocation;
+    GLuint mMarkerVertexArray;
+    GLuint mCompositeProgram;
+    GLuint mQuadVertexArray;
+
+    GLuint mStaticTexture;
+    GLuint mStaticFramebuffer;
+    GLuint mTexture;
+    GLuint mFramebuffer;
+
+    glm::mat4 mViewProjection;
+    glm::vec4 mSceneClearColor;
+    bool mStaticLayerValid;
+    bool mHasContents;
+    unsigned int mUpdateCount;
+};
@@ -0,0 +1,129 @@
+//
+// COMP 371 Labs Framework
+//
+// Multi-draw-indirect batches -- COMP371 Assignment 2
+
+#include "MultiDrawBatch.h"
+#include "GLStats.h"
+#include "RenderQueue.h"
+#include "SceneShader.h"
+#include "StreamBuffer.h"
+
+#include <cstring>
+
+using namespace glm;
+
+
+static const GLuint DRAW_DATA_BINDING = 3;
+
+
+MultiDrawBatch::MultiDrawBatch()
+    : mMeshes(NULL), mProgram(0), mFrameUploaded(false), mFrameCommandOffset(0), mFrameDrawDataOffset(0)
+{
+}
+
+
+MultiDrawBatch::~MultiDrawBatch()
+{
+    destroy();
+}
+
+
+bool MultiDrawBatch::isSupported()
+{
+    return GLEW_VERSION_4_3 && GLEW_ARB_shader_draw_parameters;
+}
+
+
+bool MultiDrawBatch::create(const MeshLibrary& meshes, ShaderPermutations& sceneShaders)
+{
+    destroy();
+    mMeshes = &meshes;
+
+    // owned by the permutations
+    mProgram = sceneShaders.program(SCENE_SHADER_DRAW_ID);
+    return mProgram != 0;
+}
+
+
+void MultiDrawBatch::destroy()
+{
+    mProgram = 0;
+    clear();
+}
+
+
+void MultiDrawBatch::clear()
+{
+    mCommands.clear();
+    mDrawData.clear();
+    mFrameUploaded = false;
+}
+
+
+void MultiDrawBatch::add(MeshId mesh, const Affine3x4& worldMatrix, const vec4& material)
+{
+    const Mesh& source = mMeshes->mesh(mesh);
+
+    DrawElementsIndirectCommand command;
+    command.count = source.indexCount;
+    command.instanceCount = 1;
+    command.firstIndex = source.firstIndex;
+    command.baseVertex = source.baseVertex;
+    command.baseInstance = 0;
+    mCommands.push_back(command);
+
+    MultiDrawData data;
+    data.worldMatrix = worldMatrix;
+    data.material = material;
+    mDrawData.push_back(data);
+}
+
+
+bool MultiDrawBatch::uploadFrame(StreamBuffer& streamBuffer)
+{
+    mFrameUploaded = false;
+    if (mCommands.empty())
+        return false;
+
+    const GLsizeiptr commandBytes = mCommands.size() * sizeof(DrawElementsIndirectCommand);
+    const GLsizeiptr drawDataBytes = mDrawData.size() * sizeof(MultiDrawData);
+
+    StreamAllocation commands = streamBuffer.allocate(commandBytes, sizeof(GLuint));
+    StreamAllocation drawData = streamBuffer.allocateStorage(drawDataBytes);
+    if (commands.data == NULL || drawData.data == NULL)
+        return false;
+
+    memcpy(commands.data, &mCommands[0], commandBytes);
+    memcpy(drawData.data, &mDrawData[0], drawDataBytes);
+    streamBuffer.flush();
+
+    mFrameCommandOffset = commands.offset;
+    mFrameDrawDataOffset = drawData.offset;
+    mFrameUploaded = true;
+    return true;
+}
+
+
+void MultiDrawBatch::render(GLStateCache& stateCache, StreamBuffer& streamBuffer, GLenum mode)
+{
+    if (mCommands.empty())
+        return;
+
+    const GLsizeiptr drawDataBytes = mDrawData.size() * sizeof(MultiDrawData);
+
+    // streamed for this call only, unless uploadFrame() already did it
+    bool uploadedBefore = mFrameUploaded;
+    if (!uploadedBefore && !uploadFrame(streamBuffer))
+        return;
+    mFrameUploaded = uploadedBefore;
+
+    stateCache.bindBufferRange(GL_SHADER_STORAGE_BUFFER, DRAW_DATA_BINDING, streamBuffer.buffer(), mFrameDrawDataOffset, drawDataBytes);
+
+    stateCache.useProgram(mProgram);
+    stateCache.setRenderState(RENDER_STATE_DEFAULT);
+    stateCache.bindVertexArray(mMeshes->vertexArray());
+
+    statsBindBuffer(GL_DRAW_INDIRECT_BUFFER, streamBuffer.buffer());
+    statsMultiDrawElementsIndirect(mode, GL_UNSIGNED_INT, (void*)mFrameCommandOffset, (GLsizei)mCommands.size(), 0);
+}
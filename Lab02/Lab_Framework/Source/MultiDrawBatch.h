@@ -0,0 +1,84 @@
+//
+// COMP 371 Labs Framework
+//
+// Multi-draw-indirect batches -- COMP371 Assignment 2
+//
+// A batch is a list of (mesh, world matrix, material) draws out of the shared
+// MeshLibrary buffers. Each draw's world matrix and material go in a shader storage
+// buffer indexed by gl_DrawIDARB (ARB_shader_draw_parameters), and the whole batch is
+// issued with a single glMultiDrawElementsIndirect. A batch has one primitive mode,
+// so a pass with lines and triangles is two batches. The draws are written to the
+// stream buffer every frame.
+
+#pragma once
+
+#define GLEW_STATIC 1
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "Affine.h"
+#include "MeshLibrary.h"
+
+class GLStateCache;
+class ShaderPermutations;
+class StreamBuffer;
+
+
+// Matches the std430 DrawData struct in the shader, 64 bytes
+struct MultiDrawData
+{
+    Affine3x4 worldMatrix;  // mat3x4 in the shader
+    glm::vec4 material;     // rgb multiplies the vertex color
+};
+
+
+class MultiDrawBatch
+{
+public:
+    MultiDrawBatch();
+    ~MultiDrawBatch();
+
+    // Needs GL 4.3 and ARB_shader_draw_parameters, check isSupported() first
+    static bool isSupported();
+
+    // Draws with the scene shader's SCENE_SHADER_DRAW_ID variant
+    bool create(const MeshLibrary& meshes, ShaderPermutations& sceneShaders);
+    void destroy();
+
+    void clear();
+    void add(MeshId mesh, const Affine3x4& worldMatrix, const glm::vec4& material = glm::vec4(1.0f));
+
+    // Writes the current draws to this frame's stream buffer once, so rendering them into
+    // several viewports does not copy them again. Lasts until clear() or the end of the
+    // frame; without it every render() streams the draws itself.
+    bool uploadFrame(StreamBuffer& streamBuffer);
+
+    // One glMultiDrawElementsIndirect for every draw in the batch, mode overrides the meshes' own.
+    // The camera block must already be bound.
+    void render(GLStateCache& stateCache, StreamBuffer& streamBuffer, GLenum mode);
+
+    size_t size() const { return mDrawData.size(); }
+
+private:
+    struct DrawElementsIndirectCommand
+    {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint baseVertex;
+        GLuint baseInstance;
+    };
+
+    const MeshLibrary* mMeshes;
+    GLuint mProgram;
+
+    std::vector<DrawElementsIndirectCommand> mCommands;
+    std::vector<MultiDrawData> mDrawData;
+
+    bool mFrameUploaded;
+    GLintptr mFrameCommandOffset;
+    GLintptr mFrameDrawDataOffset;
+};
@@ -0,0 +1,111 @@
+//
+// COMP 371 Labs Framework
+//
+// Asynchronous framebuffer readback -- COMP371 Assignment 2
+
+#include "PixelReadback.h"
+
+#include <cstring>
+#include <iostream>
+
+
+PixelReadback::PixelReadback()
+    : mNext(0)
+{
+    memset(mRing, 0, sizeof(mRing));
+}
+
+
+PixelReadback::~PixelReadback()
+{
+    destroy();
+}
+
+
+bool PixelReadback::create()
+{
+    destroy();
+
+    for (int i = 0; i < RingSize; ++i)
+        glGenBuffers(1, &mRing[i].buffer);
+    mNext = 0;
+    return true;
+}
+
+
+void PixelReadback::destroy()
+{
+    for (int i = 0; i < RingSize; ++i)
+    {
+        if (mRing[i].fence != 0)
+            glDeleteSync(mRing[i].fence);
+        if (mRing[i].buffer != 0)
+            glDeleteBuffers(1, &mRing[i].buffer);
+        memset(&mRing[i], 0, sizeof(Readback));
+    }
+}
+
+
+bool PixelReadback::read(unsigned int frameNumber, int width, int height)
+{
+    Readback& readback = mRing[mNext];
+    if (readback.buffer == 0 || readback.fence != 0 || width <= 0 || height <= 0)
+        return false;
+
+    // Plain GL calls rather than the stats wrappers, readbacks should not show up in the counts
+    GLsizeiptr size = (GLsizeiptr)width * height * 4;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+    if (size > readback.size)
+    {
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+        readback.size = size;
+    }
+
+    // RGBA rows are always 4 byte aligned, the default pack alignment is fine
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    readback.frameNumber = frameNumber;
+    readback.width = width;
+    readback.height = height;
+
+    mNext = (mNext + 1) % RingSize;
+    return true;
+}
+
+
+bool PixelReadback::finished(Readback& readback, bool wait)
+{
+    GLenum result = glClientWaitSync(readback.fence, 0, 0);
+    while (wait && result == GL_TIMEOUT_EXPIRED)
+        result = glClientWaitSync(readback.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1ms
+
+    if (result == GL_TIMEOUT_EXPIRED)
+        return false;
+    if (result == GL_WAIT_FAILED)
+        std::cerr << "PixelReadback: glClientWaitSync failed" << std::endl;
+
+    glDeleteSync(readback.fence);
+    readback.fence = 0;
+    return true;
+}
+
+
+const unsigned char* PixelReadback::map(Readback& readback)
+{
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+    GLsizeiptr size = (GLsizeiptr)readback.width * readback.height * 4;
+    const unsigned char* pixels = (const unsigned char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+    if (pixels == NULL)
+        std::cerr << "PixelReadback: could not map the readback of frame " << readback.frameNumber << std::endl;
+    return pixels;
+}
+
+
+void PixelReadback::unmap(bool mapped)
+{
+    if (mapped)
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
@@ -0,0 +1,83 @@
+//
+// COMP 371 Labs Framework
+//
+// Asynchronous framebuffer readback -- COMP371 Assignment 2
+//
+// glReadPixels into client memory waits for the GPU to finish the frame. Here it
+// reads into one of a ring of pixel pack buffers instead, which returns right away,
+// and each buffer is fenced and only mapped Lag frames later, when the copy is long
+// done. Frame capture and video recording both sit on top of this.
+
+#pragma once
+
+#define GLEW_STATIC 1
+#include <GL/glew.h>
+
+
+class PixelReadback
+{
+public:
+    static const int RingSize = 3;
+    static const int Lag = 2;   // frames between reading a buffer and mapping it
+
+    PixelReadback();
+    ~PixelReadback();
+
+    bool create();
+    void destroy();
+
+    // Starts copying the width x height back buffer as RGBA. Returns false, and reads
+    // nothing, when the buffer it would use has not been collected yet.
+    bool read(unsigned int frameNumber, int width, int height);
+
+    // Maps every readback at least Lag frames older than currentFrame, oldest first, and
+    // calls consume(rgba, frameNumber, width, height) with its pixels, bottom row first.
+    // Without wait, readbacks the GPU has not finished are left for a later call.
+    template <typename Function> void collect(unsigned int currentFrame, bool wait, Function consume)
+    {
+        collectReadbacks(currentFrame, false, wait, consume);
+    }
+
+    // Waits for and maps everything still outstanding
+    template <typename Function> void flush(Function consume)
+    {
+        collectReadbacks(0, true, true, consume);
+    }
+
+private:
+    struct Readback
+    {
+        GLuint buffer;
+        GLsync fence;           // 0 when the slot is free
+        unsigned int frameNumber;
+        int width;
+        int height;
+        GLsizeiptr size;        // allocated bytes, grows with the framebuffer
+    };
+
+    template <typename Function> void collectReadbacks(unsigned int currentFrame, bool all, bool wait, Function consume)
+    {
+        for (int i = 0; i < RingSize; ++i)
+        {
+            Readback& readback = mRing[(mNext + i) % RingSize];
+            if (readback.fence == 0)
+                continue;
+            if (!all && currentFrame - readback.frameNumber < (unsigned int)Lag)
+                break;
+            if (!finished(readback, wait))
+                break;
+
+            const unsigned char* pixels = map(readback);
+            if (pixels != NULL)
+                consume(pixels, readback.frameNumber, readback.width, readback.height);
+            unmap(pixels != NULL);
+        }
+    }
+
+    bool finished(Readback& readback, bool wait);
+    const unsigned char* map(Readback& readback);
+    void unmap(bool mapped);
+
+    Readback mRing[RingSize];
+    int mNext;
+};
@@ -0,0 +1,282 @@
+//
+// COMP 371 Labs Framework
+//
+// Draw submission -- COMP371 Assignment 2
+
+#include "RenderQueue.h"
+#include "GLStats.h"
+#include "FrameArena.h"
+
+#include <cstring>
+
+
+GLStateCache::GLStateCache()
+{
+    invalidate();
+}
+
+
+void GLStateCache::invalidate()
+{
+    mProgram = 0;
+    mVertexArray = 0;
+    mProgramKnown = false;
+    mVertexArrayKnown = false;
+    mCapabilities.clear();
+    mUniformMatrices.clear();
+    mBufferRanges.clear();
+}
+
+
+void GLStateCache::useProgram(GLuint program)
+{
+    if (mProgramKnown && mProgram == program)
+        return;
+
+    statsUseProgram(program);
+    mProgram = program;
+    mProgramKnown = true;
+}
+
+
+void GLStateCache::bindVertexArray(GLuint vertexArray)
+{
+    if (mVertexArrayKnown && mVertexArray == vertexArray)
+        return;
+
+    statsBindVertexArray(vertexArray);
+    mVertexArray = vertexArray;
+    mVertexArrayKnown = true;
+}
+
+
+GLStateCache::CapabilityState* GLStateCache::findCapability(GLenum capability)
+{
+    for (size_t i = 0; i < mCapabilities.size(); ++i)
+    {
+        if (mCapabilities[i].capability == capability)
+            return &mCapabilities[i];
+    }
+
+    CapabilityState state;
+    state.capability = capability;
+    state.enabled = -1;
+    mCapabilities.push_back(state);
+    return &mCapabilities.back();
+}
+
+
+void GLStateCache::enable(GLenum capability)
+{
+    CapabilityState* state = findCapability(capability);
+    if (state->enabled == 1)
+        return;
+
+    statsEnable(capability);
+    state->enabled = 1;
+}
+
+
+void GLStateCache::disable(GLenum capability)
+{
+    CapabilityState* state = findCapability(capability);
+    if (state->enabled == 0)
+        return;
+
+    statsDisable(capability);
+    state->enabled = 0;
+}
+
+
+void GLStateCache::setRenderState(unsigned int stateFlags)
+{
+    if (stateFlags & RENDER_STATE_DEPTH_TEST)
+        enable(GL_DEPTH_TEST);
+    else
+        disable(GL_DEPTH_TEST);
+
+    if (stateFlags & RENDER_STATE_CULL_FACE)
+        enable(GL_CULL_FACE);
+    else
+        disable(GL_CULL_FACE);
+}
+
+
+void GLStateCache::bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+    for (size_t i = 0; i < mBufferRanges.size(); ++i)
+    {
+        BufferRangeState& state = mBufferRanges[i];
+        if (state.target != target || state.index != index)
+            continue;
+
+        if (state.buffer == buffer && state.offset == offset && state.size == size)
+            return;
+
+        statsBindBufferRange(target, index, buffer, offset, size);
+        state.buffer = buffer;
+        state.offset = offset;
+        state.size = size;
+        return;
+    }
+
+    statsBindBufferRange(target, index, buffer, offset, size);
+    BufferRangeState state = { target, index, buffer, offset, size };
+    mBufferRanges.push_back(state);
+}
+
+
+void GLStateCache::uniformMatrix4(GLint location, const glm::mat4& value)
+{
+    if (location < 0)
+        return;
+
+    // uniforms are per program, the current one is the one that gets the value
+    for (size_t i = 0; i < mUniformMatrices.size(); ++i)
+    {
+        UniformMatrixState& state = mUniformMatrices[i];
+        if (state.program != mProgram || state.location != location)
+            continue;
+
+        if (memcmp(&state.value[0][0], &value[0][0], sizeof(glm::mat4)) == 0)
+            return;
+
+        statsUniformMatrix4fv(location, 1, GL_FALSE, &value[0][0]);
+        state.value = value;
+        return;
+    }
+
+    statsUniformMatrix4fv(location, 1, GL_FALSE, &value[0][0]);
+    UniformMatrixState state;
+    state.program = mProgram;
+    state.location = location;
+    state.value = value;
+    mUniformMatrices.push_back(state);
+}
+
+
+RenderQueue::RenderQueue(float depthRange)
+    : mDepthRange(depthRange)
+{
+}
+
+
+void RenderQueue::clear()
+{
+    mCommands.clear();
+    mItems.clear();
+}
+
+
+void RenderQueue::reserve(size_t count)
+{
+    mCommands.reserve(count);
+    mItems.reserve(count);
+}
+
+
+uint64_t RenderQueue::makeSortKey(GLuint program, GLuint vertexArray, unsigned int material, float depth, float depthRange, bool translucent)
+{
+    // 24 bits of depth is more than enough to order whole objects
+    float normalizedDepth = depth / depthRange;
+    if (normalizedDepth < 0.0f)
+        normalizedDepth = 0.0f;
+    if (normalizedDepth > 1.0f)
+        normalizedDepth = 1.0f;
+    uint64_t depthBits = (uint64_t)(normalizedDepth * 0xFFFFFF);
+
+    uint64_t programBits = program & 0x7FF;       // 11 bits
+    uint64_t vertexArrayBits = vertexArray & 0xFFF; // 12 bits
+    uint64_t materialBits = material & 0xFFFF;    // 16 bits
+
+    if (!translucent)
+    {
+        // opaque: | 0 | program 11 | vao 12 | material 16 | depth 24 |
+        // state changes are what costs, depth only orders draws sharing the same state
+        return (programBits << 52) | (vertexArrayBits << 40) | (materialBits << 24) | depthBits;
+    }
+
+    // translucent: | 1 | inverted depth 24 | program 11 | vao 12 | material 16 |
+    // blending needs back to front no matter what it costs in state
+    uint64_t invertedDepthBits = 0xFFFFFF - depthBits;
+    return (1ull << 63) | (invertedDepthBits << 39) | (programBits << 28) | (vertexArrayBits << 16) | materialBits;
+}
+
+
+void RenderQueue::submit(const DrawCommand& command, unsigned int material, float depth, bool translucent)
+{
+    SortItem item;
+    item.key = makeSortKey(command.program, command.vertexArray, material, depth, mDepthRange, translucent);
+    item.index = (uint32_t)mCommands.size();
+
+    mCommands.push_back(command);
+    mItems.push_back(item);
+}
+
+
+void RenderQueue::sort()
+{
+    const size_t count = mItems.size();
+    if (count < 2)
+        return;
+
+    SortItem* source = &mItems[0];
+    SortItem* destination = frameArena().allocateArray<SortItem>(count);
+
+    for (int shift = 0; shift < 64; shift += 8)
+    {
+        size_t histogram[256];
+        memset(histogram, 0, sizeof(histogram));
+
+        for (size_t i = 0; i < count; ++i)
+            histogram[(source[i].key >> shift) & 0xFF]++;
+
+        // every key has the same byte here, the pass would not move anything
+        if (histogram[(source[0].key >> shift) & 0xFF] == count)
+            continue;
+
+        size_t offset = 0;
+        for (int bucket = 0; bucket < 256; ++bucket)
+        {
+            size_t bucketCount = histogram[bucket];
+            histogram[bucket] = offset;
+            offset += bucketCount;
+        }
+
+        for (size_t i = 0; i < count; ++i)
+            destination[histogram[(source[i].key >> shift) & 0xFF]++] = source[i];
+
+        SortItem* swap = source;
+        source = destination;
+        destination = swap;
+    }
+
+    if (source != &mItems[0])
+        memcpy(&mItems[0], source, count * sizeof(SortItem));
+}
+
+
+void RenderQueue::execute(GLStateCache& stateCache, const glm::mat4& viewProjection)
+{
+    if (mItems.empty())
+        return;
+
+    // every matrix in one pass, in draw order
+    Affine3x4* sortedWorlds = frameArena().allocateArray<Affine3x4>(mItems.size());
+    glm::mat4* modelViewProjections = frameArena().allocateArray<glm::mat4>(mItems.size());
+    for (size_t i = 0; i < mItems.size(); ++i)
+        sortedWorlds[i] = mCommands[mItems[i].index].worldMatrix;
+    multiplyAffineBatch(viewProjection, sortedWorlds, mItems.size(), modelViewProjections);
+
+    for (size_t i = 0; i < mItems.size(); ++i)
+    {
+        const DrawCommand& command = mCommands[mItems[i].index];
+
+        stateCache.useProgram(command.program);
+        stateCache.setRenderState(command.stateFlags);
+        stateCache.bindVertexArray(command.vertexArray);
+        stateCache.uniformMatrix4(command.modelViewProjectionLocation, modelViewProjections[i]);
+
+        statsDrawArrays(command.mode, command.first, command.count);
+    }
+}
@@ -0,0 +1,140 @@
+//
+// COMP 371 Labs Framework
+//
+// Draw submission -- COMP371 Assignment 2
+//
+// Draws are recorded into a RenderQueue with a 64-bit sort key, radix sorted, and
+// issued through a GLStateCache that keeps a shadow copy of the GL state so binds,
+// enables and uniform uploads that would not change anything are never sent.
+// Draws carry their world transform; the model-view-projection of the whole queue
+// is computed in one batch at execute time so shaders get a single matrix. Sort
+// scratch and the matrix batch come from the frame arena.
+
+#pragma once
+
+#define GLEW_STATIC 1
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <stdint.h>
+
+#include "Affine.h"
+
+
+// Fixed function state a draw needs, switched through the cache
+enum RenderStateFlags
+{
+    RENDER_STATE_DEPTH_TEST = 1 << 0,
+    RENDER_STATE_CULL_FACE  = 1 << 1,
+
+    RENDER_STATE_DEFAULT = RENDER_STATE_DEPTH_TEST | RENDER_STATE_CULL_FACE
+};
+
+
+class GLStateCache
+{
+public:
+    GLStateCache();
+
+    // Forget everything, use after code that talks to GL directly
+    void invalidate();
+
+    void useProgram(GLuint program);
+    void bindVertexArray(GLuint vertexArray);
+    void enable(GLenum capability);
+    void disable(GLenum capability);
+    void setRenderState(unsigned int stateFlags);
+    void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+
+    // Uploads only if the value differs from the last one sent for this program/location
+    void uniformMatrix4(GLint location, const glm::mat4& value);
+
+    GLuint currentProgram() const { return mProgram; }
+
+private:
+    struct CapabilityState
+    {
+        GLenum capability;
+        int enabled; // -1 when unknown
+    };
+
+    struct UniformMatrixState
+    {
+        GLuint program;
+        GLint location;
+        glm::mat4 value;
+    };
+
+    struct BufferRangeState
+    {
+        GLenum target;
+        GLuint index;
+        GLuint buffer;
+        GLintptr offset;
+        GLsizeiptr size;
+    };
+
+    CapabilityState* findCapability(GLenum capability);
+
+    GLuint mProgram;
+    GLuint mVertexArray;
+    bool mProgramKnown;
+    bool mVertexArrayKnown;
+    std::vector<CapabilityState> mCapabilities;
+    std::vector<UniformMatrixState> mUniformMatrices;
+    std::vector<BufferRangeState> mBufferRanges;
+};
+
+
+struct DrawCommand
+{
+    GLuint program;
+    GLuint vertexArray;
+    GLint modelViewProjectionLocation;
+    unsigned int stateFlags;
+    GLenum mode;
+    GLint first;
+    GLsizei count;
+    Affine3x4 worldMatrix;  // multiplied with the view-projection for the uniform
+};
+
+
+class RenderQueue
+{
+public:
+    // depthRange maps view depths to the key, anything farther lands in the last bucket
+    RenderQueue(float depthRange = 100.0f);
+
+    void clear();
+
+    // Room for count draws, so a queue that grows does not allocate mid-frame
+    void reserve(size_t count);
+
+    // material is any small id that groups draws sharing the same inputs (colors, textures, state)
+    // depth is the view-space distance of the draw, opaque draws end up front to back and
+    // translucent ones back to front after all the opaque ones
+    void submit(const DrawCommand& command, unsigned int material, float depth, bool translucent = false);
+
+    // LSD radix sort of the keys, 8 bits per pass; passes where every key has the same byte are skipped
+    void sort();
+
+    // Issue the draws in sorted order through the state cache
+    void execute(GLStateCache& stateCache, const glm::mat4& viewProjection);
+
+    size_t size() const { return mCommands.size(); }
+
+    static uint64_t makeSortKey(GLuint program, GLuint vertexArray, unsigned int material, float depth, float depthRange, bool translucent);
+
+private:
+    struct SortItem
+    {
+        uint64_t key;
+        uint32_t index;
+    };
+
+    float mDepthRange;
+    std::vector<DrawCommand> mCommands;
+    std::vector<SortItem> mItems;
+};
@@ -0,0 +1,234 @@
+//
+// COMP 371 Labs Framework
+//
+// Render thread -- COMP371 Assignment 2
+
+#include "RenderThread.h"
+#include "AllocationTracker.h"
+#include "FrameArena.h"
+
+#include <GLFW/glfw3.h>
+
+#include <cstdio>
+
+
+RenderThread::RenderThread()
+    : mWindow(NULL)
+    , mThreaded(false)
+    , mReady(false)
+    , mCreated(false)
+    , mSummaryChanged(false)
+    , mBenchmarkDone(false)
+    , mSleepers(0)
+    , mGoldenMismatches(0)
+{
+    mSummary[0] = '\0';
+}
+
+
+bool RenderThread::start(GLFWwindow* window, const RenderOptions& options, bool threaded)
+{
+    mWindow = window;
+    mThreaded = threaded;
+
+    if (mThreaded)
+    {
+        // a context is current on one thread at a time
+        glfwMakeContextCurrent(NULL);
+        mThread = std::thread(&RenderThread::threadMain, this, options);
+
+        std::unique_lock<std::mutex> lock(mMutex);
+        mStarted.wait(lock, [this]() { return mReady; });
+        if (!mCreated)
+        {
+            lock.unlock();
+            mThread.join();
+            glfwMakeContextCurrent(mWindow);
+            return false;
+        }
+    }
+    else
+    {
+        mCreated = mRenderer.create(options);
+        if (!mCreated)
+        {
+            mRenderer.destroy();
+            return false;
+        }
+        mPacer.create(options.swapMode, options.frameLimit);
+    }
+
+    // full size up front, a growing crowd list would allocate in the middle of a frame
+    for (int i = 0; i < PacketCount; ++i)
+    {
+        if (options.crowdCount > 0 && mRenderer.usesGpuCulling())
+            mPackets[i].crowdInstances.reserve(options.crowdCount);
+        else if (options.crowdCount > 0)
+        {
+            mPackets[i].crowdDrawList.worldMatrices.reserve(options.crowdCount);
+            mPackets[i].crowdDrawList.impostors.reserve(mRenderer.usesImpostors() ? options.crowdCount : 0);
+        }
+        if (options.minimap)
+            mPackets[i].minimapMarkers.reserve(options.crowdCount + 1);
+        mFreePackets.push(&mPackets[i]);
+    }
+    return true;
+}
+
+
+unsigned int RenderThread::stop()
+{
+    if (!mCreated)
+        return 0;
+
+    if (mThreaded)
+    {
+        // behind every packet still queued, the thread renders those first
+        waitFor([this]() { return mSubmittedPackets.push(NULL); });
+        wakeOtherSide();
+        mThread.join();
+        glfwMakeContextCurrent(mWindow);
+    }
+    else
+    {
+        mPacer.destroy();
+        mGoldenMismatches = mRenderer.destroy();
+    }
+
+    mCreated = false;
+    return mGoldenMismatches;
+}
+
+
+FramePacket* RenderThread::acquirePacket()
+{
+    FramePacket* packet = NULL;
+    waitFor([this, &packet]() { return mFreePackets.pop(packet); });
+    return packet;
+}
+
+
+void RenderThread::submit(FramePacket* packet)
+{
+    if (!mThreaded)
+    {
+        render(packet);
+        return;
+    }
+
+    // never fails, there are as many slots as packets
+    mSubmittedPackets.push(packet);
+    wakeOtherSide();
+}
+
+
+bool RenderThread::takeSummary(char* buffer, size_t bufferSize)
+{
+    if (!mSummaryChanged)
+        return false;
+
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    snprintf(buffer, bufferSize, "%s", mSummary);
+    mSummaryChanged = false;
+    return true;
+}
+
+
+template <typename Ready>
+void RenderThread::waitFor(Ready ready)
+{
+    // the other side is usually a moment away, spin a little before giving the core away
+    for (int spins = 0; spins < 64; ++spins)
+    {
+        if (ready())
+            return;
+        std::this_thread::yield();
+    }
+
+    std::unique_lock<std::mutex> lock(mWakeMutex);
+    mSleepers.fetch_add(1);
+    // pairs with the fence in wakeOtherSide(): either this retry sees the other side's
+    // push or pop, or the other side sees mSleepers and notifies under the lock
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    mWake.wait(lock, ready);
+    mSleepers.fetch_sub(1);
+}
+
+
+void RenderThread::wakeOtherSide()
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (mSleepers.load() == 0)
+        return;
+
+    std::lock_guard<std::mutex> lock(mWakeMutex);
+    mWake.notify_all();
+}
+
+
+void RenderThread::threadMain(RenderOptions options)
+{
+    AllocationTracker::setThreadName("render");
+    glfwMakeContextCurrent(mWindow);
+
+    bool created = mRenderer.create(options);
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mCreated = created;
+        mReady = true;
+    }
+    mStarted.notify_one();
+
+    if (created)
+    {
+        mPacer.create(options.swapMode, options.frameLimit);
+
+        for (;;)
+        {
+            FramePacket* packet = NULL;
+            waitFor([this, &packet]() { return mSubmittedPackets.pop(packet); });
+            // frees a slot stop() may be waiting for
+            wakeOtherSide();
+
+            if (packet == NULL)
+                break;
+
+            AllocationTracker::beginThreadFrame();
+            render(packet);
+            AllocationTracker::endThreadFrame();
+        }
+        mPacer.destroy();
+    }
+
+    mGoldenMismatches = mRenderer.destroy();
+    glfwMakeContextCurrent(NULL);
+}
+
+
+void RenderThread::render(FramePacket* packet)
+{
+    mRenderer.renderFrame(*packet);
+
+    // the summary changes about once a second, only then is the lock taken
+    char summary[sizeof(mSummary)];
+    if (mRenderer.takeSummary(summary, sizeof(summary)))
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        snprintf(mSummary, sizeof(mSummary), "%s", summary);
+        mSummaryChanged = true;
+    }
+    if (mRenderer.benchmarkDone())
+        mBenchmarkDone = true;
+
+    // the packet is free as soon as it is drawn, the main thread fills it while this one waits in the swap
+    mFreePackets.push(packet);
+    if (mThreaded)
+        wakeOtherSide();
+
+    // End Frame
+    frameArena().reset();
+    mPacer.waitForFrame();
+    glfwSwapBuffers(mWindow);
+    mPacer.frameSwapped();
+}
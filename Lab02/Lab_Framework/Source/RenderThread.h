@@ -0,0 +1,95 @@
+//
+// COMP 371 Labs Framework
+//
+// Render thread -- COMP371 Assignment 2
+//
+// Moves the GL context and the SceneRenderer onto a thread of their own. The main
+// thread polls input, simulates and fills a FramePacket, then submits it; the render
+// thread draws it, swaps and hands the packet back. Packets travel through two
+// lock-free queues, so the simulation of the next frame overlaps the GL calls of the
+// previous one and neither side allocates per frame. A side that finds its queue
+// empty (or full) spins briefly, then sleeps on a condition variable; the other side
+// takes the lock to wake it only when someone sleeps, so an idle --on-demand scene
+// leaves the render thread blocked instead of polling. With
+// PacketCount packets the main thread runs at most that many frames ahead, so the
+// FramePacer here, which sets the swap interval and limits the frame rate, paces
+// the simulation too.
+
+#pragma once
+
+#include "FramePacer.h"
+#include "FramePacket.h"
+#include "SceneRenderer.h"
+#include "SpscQueue.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+struct GLFWwindow;
+
+
+class RenderThread
+{
+public:
+    static const int PacketCount = 2;
+
+    RenderThread();
+
+    // Creates the renderer with the window's context, which must be current on the
+    // calling thread. threaded moves the context to the render thread; otherwise
+    // submit() renders and swaps right away, for comparing against a single thread.
+    bool start(GLFWwindow* window, const RenderOptions& options, bool threaded);
+
+    // Renders what was submitted, destroys the renderer and returns how many captured
+    // frames missed their golden image
+    unsigned int stop();
+
+    // A packet to fill for the next frame, waits while the render thread is PacketCount frames behind
+    FramePacket* acquirePacket();
+    void submit(FramePacket* packet);
+
+    // Stats summary for the window title, empty when stats are off. True when it changed since the last call.
+    bool takeSummary(char* buffer, size_t bufferSize);
+
+    bool benchmarkDone() const { return mBenchmarkDone.load(); }
+
+    // Fixed once started, safe to read from the main thread
+    const MeshLibrary& meshes() const { return mRenderer.meshes(); }
+    bool usesGpuCulling() const { return mRenderer.usesGpuCulling(); }
+    bool usesImpostors() const { return mRenderer.usesImpostors(); }
+
+private:
+    void threadMain(RenderOptions options);
+    void render(FramePacket* packet);
+
+    // Spins a little, then sleeps until ready() is true; ready is retried under mWakeMutex
+    template <typename Ready>
+    void waitFor(Ready ready);
+    // Called after pushing or popping a queue, wakes the other thread if it sleeps
+    void wakeOtherSide();
+
+    GLFWwindow* mWindow;
+    bool mThreaded;
+    SceneRenderer mRenderer;
+    FramePacer mPacer;
+
+    FramePacket mPackets[PacketCount];
+    SpscQueue<FramePacket*, PacketCount + 1> mFreePackets;      // render thread to main thread
+    SpscQueue<FramePacket*, PacketCount + 1> mSubmittedPackets; // main thread to render thread, NULL stops it
+
+    std::thread mThread;
+    std::mutex mMutex;
+    std::condition_variable mStarted;
+    bool mReady;            // create() returned, under mMutex
+    bool mCreated;
+    char mSummary[200];     // under mMutex
+    std::atomic<bool> mSummaryChanged;  // set under mMutex, read without it to skip the lock
+    std::atomic<bool> mBenchmarkDone;
+
+    std::mutex mWakeMutex;
+    std::condition_variable mWake;
+    std::atomic<int> mSleepers;     // threads waiting on mWake, changed under mWakeMutex
+    unsigned int mGoldenMismatches;
+};
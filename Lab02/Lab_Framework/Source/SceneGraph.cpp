@@ -0,0 +1,82 @@
+//
+// COMP 371 Labs Framework
+//
+// Scene graph with dirty-flag transform propagation -- COMP371 Assignment 2
+
+#include "SceneGraph.h"
+
+#include <cassert>
+
+using namespace glm;
+
+
+SceneGraph::SceneGraph()
+    : mFirstDirty(0)
+{
+}
+
+
+SceneNodeId SceneGraph::createNode(SceneNodeId parent, const Affine3x4& localTransform)
+{
+    SceneNodeId node = (SceneNodeId)mParents.size();
+    assert(parent >= SCENE_NODE_NONE && parent < node);
+
+    mParents.push_back(parent);
+    mLocal.push_back(localTransform);
+    mWorld.push_back(localTransform);
+    mDirty.push_back(1);
+    mChanged.push_back(0);
+
+    if (node < mFirstDirty)
+        mFirstDirty = node;
+    return node;
+}
+
+
+void SceneGraph::clear()
+{
+    mParents.clear();
+    mLocal.clear();
+    mWorld.clear();
+    mDirty.clear();
+    mChanged.clear();
+    mChangedNodes.clear();
+    mFirstDirty = 0;
+}
+
+
+void SceneGraph::setLocalTransform(SceneNodeId node, const Affine3x4& localTransform)
+{
+    mLocal[node] = localTransform;
+    mDirty[node] = 1;
+    if (node < mFirstDirty)
+        mFirstDirty = node;
+}
+
+
+size_t SceneGraph::update()
+{
+    for (size_t i = 0; i < mChangedNodes.size(); ++i)
+        mChanged[mChangedNodes[i]] = 0;
+    mChangedNodes.clear();
+
+    SceneNodeId count = (SceneNodeId)mParents.size();
+    for (SceneNodeId node = mFirstDirty; node < count; ++node)
+    {
+        // parents are stored first, so a flagged parent has already set ours
+        SceneNodeId parent = mParents[node];
+        if (parent != SCENE_NODE_NONE && mChanged[parent])
+            mDirty[node] = 1;
+
+        if (!mDirty[node])
+            continue;
+
+        mWorld[node] = parent == SCENE_NODE_NONE ? mLocal[node] : mWorld[parent] * mLocal[node];
+        mDirty[node] = 0;
+        mChanged[node] = 1;
+        mChangedNodes.push_back(node);
+    }
+
+    mFirstDirty = count;
+    return mChangedNodes.size();
+}
@@ -0,0 +1,66 @@
+//
+// COMP 371 Labs Framework
+//
+// Scene graph with dirty-flag transform propagation -- COMP371 Assignment 2
+//
+// Nodes live in flat arrays and a node can only be parented to a node created before
+// it, so walking the arrays in order always visits parents before their children.
+// setLocalTransform() only flags the node; update() makes one pass from the first
+// dirty node onwards, passes the flag down to children as it goes and recomputes
+// the world transform of flagged nodes only. With nothing flagged update() returns
+// straight away.
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "Affine.h"
+#include "Transform.h"
+
+
+typedef int SceneNodeId;
+
+static const SceneNodeId SCENE_NODE_NONE = -1;
+
+
+class SceneGraph
+{
+public:
+    SceneGraph();
+
+    // parent has to be SCENE_NODE_NONE or an existing node
+    SceneNodeId createNode(SceneNodeId parent, const Affine3x4& localTransform);
+    SceneNodeId createNode(SceneNodeId parent, const glm::mat4& localTransform) { return createNode(parent, toAffine(localTransform)); }
+    SceneNodeId createNode(SceneNodeId parent, const Transform& localTransform) { return createNode(parent, toAffine(localTransform)); }
+    void clear();
+
+    void setLocalTransform(SceneNodeId node, const Affine3x4& localTransform);
+    void setLocalTransform(SceneNodeId node, const glm::mat4& localTransform) { setLocalTransform(node, toAffine(localTransform)); }
+    void setLocalTransform(SceneNodeId node, const Transform& localTransform) { setLocalTransform(node, toAffine(localTransform)); }
+    const Affine3x4& localTransform(SceneNodeId node) const { return mLocal[node]; }
+
+    // Valid after update()
+    const Affine3x4& worldTransform(SceneNodeId node) const { return mWorld[node]; }
+
+    // True if the world transform was recomputed by the last update()
+    bool worldChanged(SceneNodeId node) const { return mChanged[node] != 0; }
+
+    SceneNodeId parent(SceneNodeId node) const { return mParents[node]; }
+    size_t size() const { return mParents.size(); }
+
+    // Recomputes the world transforms of dirty nodes and their descendants,
+    // returns the number of nodes that were recomputed
+    size_t update();
+
+private:
+    std::vector<SceneNodeId> mParents;
+    std::vector<Affine3x4> mLocal;
+    std::vector<Affine3x4> mWorld;
+    std::vector<unsigned char> mDirty;
+    std::vector<unsigned char> mChanged;
+
+    SceneNodeId mFirstDirty;                // lowest flagged node, size() when clean
+    std::vector<SceneNodeId> mChangedNodes; // what the last update flagged changed, to reset next time
+};
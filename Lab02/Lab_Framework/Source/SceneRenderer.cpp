@@ -0,0 +1,444 @@
+//
+// COMP 371 Labs Framework
+//
+// Scene rendering from frame packets -- COMP371 Assignment 2
+
+#include "SceneRenderer.h"
+#include "AllocationTracker.h"
+#include "FrameArena.h"
+#include "FramePacket.h"
+#include "Frustum.h"
+#include "GLStats.h"
+#include "SceneShader.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+using namespace glm;
+
+
+// Material ids for the render queue sort key
+enum Material
+{
+    MATERIAL_GRID = 0,
+    MATERIAL_SNOW,
+    MATERIAL_NOSE
+};
+
+
+// The MULTI_VIEW scene shader's std140 camera block
+struct MultiViewFrameData
+{
+    mat4 viewProjections[SCENE_MAX_VIEWS];
+    GLint viewCount;
+    GLint padding[3];
+};
+
+
+SceneRenderer::SceneRenderer()
+    : mShaderProgram(0)
+    , mModelViewProjectionLocation(-1)
+    , mMultiDraw(false)
+    , mRecording(false)
+    , mFramesRendered(0)
+    , mLastSummaryTime(0.0f)
+    , mSummaryChanged(false)
+    , mBenchmarkDone(false)
+{
+    memset(&mOptions, 0, sizeof(mOptions));
+    mSummary[0] = '\0';
+}
+
+
+bool SceneRenderer::create(const RenderOptions& options)
+{
+    mOptions = options;
+
+    // Compile and link shaders here ... -- taken from lab
+    // every scene program is a variant of the one scene shader, this one has no features
+    createSceneShader(mSceneShaders);
+    mShaderProgram = mSceneShaders.program(0);
+    mModelViewProjectionLocation = glGetUniformLocation(mShaderProgram, "modelViewProjection");
+
+    // Variants the options will draw with, compiled now instead of on the first frame that needs them
+    std::vector<unsigned int> sceneVariants;
+    if (options.crowdCount > 0)
+        sceneVariants.push_back(SCENE_SHADER_INSTANCE_ATTRIBUTE);
+    if (options.crowdCount > 0 && options.gpuCulling && GLEW_VERSION_4_3)
+        sceneVariants.push_back(SCENE_SHADER_INSTANCE_STORAGE);
+    if (options.multiDraw && MultiDrawBatch::isSupported())
+        sceneVariants.push_back(SCENE_SHADER_DRAW_ID);
+    if (options.crowdCount > 0 && options.viewportCount > 1 && isMultiViewSupported())
+        sceneVariants.push_back(SCENE_SHADER_INSTANCE_ATTRIBUTE | SCENE_SHADER_MULTI_VIEW);
+    if (!sceneVariants.empty())
+        mSceneShaders.precompile(&sceneVariants[0], sceneVariants.size());
+
+    // Call counting and pipeline statistics, always on for benchmarks
+    GLStats::initialize(options.glStats || options.benchmarkFrames > 0);
+    if (options.benchmarkFrames > 0)
+        GLStats::recordHistory(options.benchmarkFrames);
+
+    // Backface culling and depth test are part of each draw's render state
+    mStateCache.useProgram(mShaderProgram);
+    mStateCache.setRenderState(RENDER_STATE_DEFAULT);
+
+    // Per-frame data (camera block, crowd matrices when culled on the CPU) is streamed
+    mStreamBuffer.create(256 * 1024 + options.crowdCount * sizeof(Affine3x4));
+
+    // Define and upload geometry to the GPU here ...
+    mMeshLibrary.create();
+    if (options.crowdCount > 0)
+        mCrowdRenderer.create(mMeshLibrary, mSceneShaders, options.gpuCulling);
+
+    // Far snowmen as billboards, the atlas is rendered right away
+    if (options.crowdCount > 0 && options.impostorDistance > 0.0f && !mCrowdRenderer.usesGpuCulling()
+        && !mImpostors.create(mMeshLibrary, mShaderProgram, mModelViewProjectionLocation))
+        std::cout << "Impostors could not be created, drawing every snowman as a mesh" << std::endl;
+    mStateCache.invalidate();
+
+    // Coordinate axes and floor grid never move, they are baked into world space once
+    // and drawn a 25 unit chunk of ground at a time
+    mStaticBatch.create(mShaderProgram, mModelViewProjectionLocation);
+    mStaticBatch.add(mMeshLibrary, MESH_AXIS_X, toAffine(scale(mat4(1.0f), vec3(5.0f, 1.0f, 1.0f))), MATERIAL_GRID, RENDER_STATE_DEFAULT);
+    mStaticBatch.add(mMeshLibrary, MESH_AXIS_Y, toAffine(scale(mat4(1.0f), vec3(1.0f, 5.0f, 1.0f))), MATERIAL_GRID, RENDER_STATE_DEFAULT);
+    mStaticBatch.add(mMeshLibrary, MESH_AXIS_Z, toAffine(scale(mat4(1.0f), vec3(1.0f, 1.0f, 5.0f))), MATERIAL_GRID, RENDER_STATE_DEFAULT);
+    for (int i = 0; i <= 100; ++i)
+    {
+        mStaticBatch.add(mMeshLibrary, MESH_GRID_LINE_X, toAffine(translate(mat4(1.0f), vec3(-50.0f, -50.0f + i * 1.0f, -2.0f)) * scale(mat4(1.0f), vec3(100.0f, 1.0f, 1.0f))),
+                         MATERIAL_GRID, RENDER_STATE_DEFAULT);
+        mStaticBatch.add(mMeshLibrary, MESH_GRID_LINE_Y, toAffine(translate(mat4(1.0f), vec3(-50.0f + i * 1.0f, -50.0f, -2.0f)) * scale(mat4(1.0f), vec3(1.0f, 100.0f, 1.0f))),
+                         MATERIAL_GRID, RENDER_STATE_DEFAULT);
+    }
+    mStaticBatch.build(25.0f);
+
+    // Multi-draw path: olaf's parts are one streamed batch
+    mMultiDraw = options.multiDraw;
+    if (mMultiDraw && !MultiDrawBatch::isSupported())
+    {
+        std::cout << "Multi-draw needs OpenGL 4.3 and ARB_shader_draw_parameters, using the render queue" << std::endl;
+        mMultiDraw = false;
+    }
+    if (mMultiDraw)
+        mMultiDraw = mOlafBatch.create(mMeshLibrary, mSceneShaders);
+
+    // A draw per crowd member goes through the render queue, which multi-draw and GPU culling bypass
+    if (options.crowdDraws && (mMultiDraw || mCrowdRenderer.usesGpuCulling()))
+    {
+        std::cout << "Crowd draws need the render queue and CPU culling, drawing the crowd instanced" << std::endl;
+        mOptions.crowdDraws = false;
+    }
+    if (mOptions.crowdDraws)
+        mRenderQueue.reserve(SNOWMAN_PART_COUNT + options.crowdCount);
+
+    // Otherwise small parts are transformed on the CPU and drawn once per material
+    mDynamicBatch.create(mMeshLibrary, mShaderProgram, mModelViewProjectionLocation, mStreamBuffer.buffer(), options.dynamicBatchVertices);
+
+    // The minimap caches the static batch and redraws the markers only when a packet brings new ones
+    if (options.minimap && !mMinimap.create(mShaderProgram, mModelViewProjectionLocation, mStreamBuffer.buffer()))
+        std::cout << "Minimap could not be created, drawing without it" << std::endl;
+
+    // Captured frames are read back a couple of frames late and written on their own thread
+    if (options.captureInterval > 0)
+        mFrameCapture.create(options.captureDirectory, options.goldenDirectory, options.tolerance, options.tolerancePixels);
+
+    // Recording reads back every frame but never waits for the disk
+    mRecording = options.recordPath != NULL && mVideoRecorder.create(options.recordPath, options.recordFramesPerSecond);
+
+    // Temporary per-frame data (sort scratch, matrix batches) comes from this thread's
+    // frame arena, sized up front so even the first frames stay off the heap
+    frameArena().reserve(FrameArena::DefaultCapacity);
+
+    return true;
+}
+
+
+unsigned int SceneRenderer::destroy()
+{
+    mVideoRecorder.destroy();
+    unsigned int goldenMismatches = mFrameCapture.destroy();
+    if (mOptions.captureInterval > 0)
+    {
+        std::cout << mFrameCapture.framesCaptured() << " frames captured to " << mOptions.captureDirectory << std::endl;
+        if (mOptions.goldenDirectory != NULL)
+            std::cout << goldenMismatches << " of them differ from the golden images in " << mOptions.goldenDirectory << std::endl;
+    }
+
+    if (mMinimap.isCreated())
+        std::cout << "Minimap updated " << mMinimap.updateCount() << " times in " << mFramesRendered << " frames" << std::endl;
+    mMinimap.destroy();
+    mImpostors.destroy();
+    mCrowdRenderer.destroy();
+    mStaticBatch.destroy();
+    mDynamicBatch.destroy();
+    mLodLibrary.destroy();
+    mOlafBatch.destroy();
+    mMeshLibrary.destroy();
+    mSceneShaders.destroy();
+    mStreamBuffer.destroy();
+    GLStats::shutdown();
+
+    return goldenMismatches;
+}
+
+
+void SceneRenderer::renderFrame(const FramePacket& packet)
+{
+    // F1 toggles GL stats, the title goes back to its default when they go off
+    if (packet.toggleStats)
+    {
+        GLStats::setEnabled(!GLStats::isEnabled());
+        if (!GLStats::isEnabled())
+        {
+            mSummary[0] = '\0';
+            mSummaryChanged = true;
+        }
+    }
+
+    GLStats::beginFrame();
+
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    // One camera block per view, all written first in this frame's third of the stream
+    // buffer: the instanced paths read it from binding 0, the rest multiply the view's
+    // view-projection with their world transforms on the CPU
+    const int viewCount = packet.viewCount;
+    mStreamBuffer.beginFrame();
+    StreamAllocation viewData[SCENE_MAX_VIEWS];
+    for (int view = 0; view < viewCount; ++view)
+    {
+        viewData[view] = mStreamBuffer.allocateUniform(sizeof(mat4));
+        memcpy(viewData[view].data, &packet.views[view].viewProjection[0][0], sizeof(mat4));
+    }
+
+    // With several views the CPU culled crowd goes out once, each instance drawn into
+    // every viewport of a viewport array; the camera block then holds all the views
+    const bool crowdOnePass = viewCount > 1 && mOptions.crowdCount > 0 && !mCrowdRenderer.usesGpuCulling() && !mOptions.crowdDraws
+                           && mCrowdRenderer.supportsMultiView();
+    StreamAllocation multiViewData;
+    if (crowdOnePass)
+    {
+        MultiViewFrameData frameData;
+        memset(&frameData, 0, sizeof(frameData));
+        for (int view = 0; view < viewCount; ++view)
+            frameData.viewProjections[view] = packet.views[view].viewProjection;
+        frameData.viewCount = viewCount;
+        multiViewData = mStreamBuffer.allocateUniform(sizeof(frameData));
+        memcpy(multiViewData.data, &frameData, sizeof(frameData));
+    }
+    mStreamBuffer.flush();
+
+    // Off screen first, then the scene's viewports
+    if (packet.minimapChanged && mMinimap.isCreated())
+    {
+        mMinimap.update(mStateCache, mStreamBuffer, mStaticBatch, packet.minimapMarkers.empty() ? NULL : &packet.minimapMarkers[0],
+                        packet.minimapMarkers.size(), 0, 0, packet.framebufferWidth, packet.framebufferHeight);
+    }
+
+    // Everything below is uploaded or sorted once and drawn into every view
+    const Affine3x4& olaf1 = packet.olafParts[SNOWMAN_BODY];
+    const Affine3x4& olaf2 = packet.olafParts[SNOWMAN_TORSO];
+    const Affine3x4& olaf3 = packet.olafParts[SNOWMAN_HEAD];
+    const Affine3x4& nose = packet.olafParts[SNOWMAN_NOSE];
+
+    if (mMultiDraw)
+    {
+        mOlafBatch.clear();
+        mOlafBatch.add(MESH_CUBE, olaf1);
+        mOlafBatch.add(MESH_CUBE, olaf2);
+        mOlafBatch.add(MESH_CUBE, olaf3);
+        mOlafBatch.add(MESH_NOSE, nose);
+        if (viewCount > 1)
+            mOlafBatch.uploadFrame(mStreamBuffer);
+    }
+    else
+    {
+        static const MeshId partMeshes[SNOWMAN_PART_COUNT] = { MESH_CUBE, MESH_CUBE, MESH_CUBE, MESH_NOSE };
+        static const Material partMaterials[SNOWMAN_PART_COUNT] = { MATERIAL_SNOW, MATERIAL_SNOW, MATERIAL_SNOW, MATERIAL_NOSE };
+        const mat4& viewMatrix = packet.views[0].viewMatrix;
+
+        // Parts small enough for the dynamic batch are transformed into the stream buffer
+        // once for every view, the rest are queued with their own matrix
+        mDynamicBatch.clear();
+        mRenderQueue.clear();
+        for (int part = 0; part < SNOWMAN_PART_COUNT; ++part)
+        {
+            const Affine3x4& world = packet.olafParts[part];
+            if (mDynamicBatch.add(partMeshes[part], world, packet.olafRenderMode, partMaterials[part], RENDER_STATE_DEFAULT))
+                continue;
+
+            const Mesh& mesh = mMeshLibrary.mesh(partMeshes[part]);
+            DrawCommand olafPart = { mShaderProgram, mMeshLibrary.vertexArray(), mModelViewProjectionLocation, RENDER_STATE_DEFAULT, packet.olafRenderMode,
+                                     mesh.baseVertex, mesh.vertexCount, world };
+            mRenderQueue.submit(olafPart, partMaterials[part], -(viewMatrix * vec4(affineTranslation(world), 1.0f)).z);
+        }
+        mDynamicBatch.upload(mStreamBuffer);
+
+        // Every visible crowd member as a draw of its own, what a scene without instancing
+        // costs the queue's sort, matrix batch and state cache. With LOD chains each one
+        // draws the coarsest level that stays under a pixel of error in the main view.
+        if (mOptions.crowdDraws)
+        {
+            if (packet.lodChains != NULL && !mLodLibrary.isCreated())
+                mLodLibrary.create(packet.lodChains);
+
+            // the projection's scale at distance 1, in pixels
+            const FrameView& mainView = packet.views[0];
+            const float pixelsPerUnit = (mainView.viewProjection * inverse(viewMatrix))[1][1] * 0.5f * (float)mainView.height;
+            const float maxPixelError = 1.0f;
+
+            const CrowdDrawList& drawList = packet.crowdDrawList;
+            size_t member = 0;
+            for (int meshId = 0; meshId < MESH_COUNT; ++meshId)
+            {
+                const Mesh& mesh = mMeshLibrary.mesh((MeshId)meshId);
+                for (GLsizei i = 0; i < drawList.meshCounts[meshId]; ++i, ++member)
+                {
+                    const Affine3x4& world = drawList.worldMatrices[member];
+                    const float depth = -(viewMatrix * vec4(affineTranslation(world), 1.0f)).z;
+                    DrawCommand crowdMember = { mShaderProgram, mMeshLibrary.vertexArray(), mModelViewProjectionLocation, RENDER_STATE_DEFAULT, mesh.mode,
+                                                mesh.baseVertex, mesh.vertexCount, world };
+                    if (mLodLibrary.select((MeshId)meshId, depth, pixelsPerUnit, maxPixelError, crowdMember.first, crowdMember.count))
+                        crowdMember.vertexArray = mLodLibrary.vertexArray();
+                    mRenderQueue.submit(crowdMember, MATERIAL_SNOW, depth);
+                }
+            }
+        }
+
+        // grouped by material, front to back inside each group, by the main view's depth
+        mRenderQueue.sort();
+    }
+
+    // Crowd, culled on the GPU from the uploaded instances or drawn from the simulation's
+    // visible list, which already covers every view
+    const bool drawCrowd = mOptions.crowdCount > 0;
+    CrowdStreamedList crowdList;
+    StreamAllocation impostors = {};
+    const GLsizei impostorCount = (GLsizei)packet.crowdDrawList.impostors.size();
+    if (drawCrowd && mCrowdRenderer.usesGpuCulling())
+    {
+        if (packet.crowdInstancesChanged)
+        {
+            const CrowdInstance* instances = packet.crowdInstances.empty() ? NULL : &packet.crowdInstances[0];
+            if (packet.crowdInstances.size() == packet.crowdInstanceTotal)
+                mCrowdRenderer.setInstances(instances, packet.crowdInstances.size());
+            else
+                mCrowdRenderer.updateInstances(packet.crowdInstanceFirst, instances, packet.crowdInstances.size());
+        }
+    }
+    else if (drawCrowd)
+    {
+        if (!mOptions.crowdDraws)
+            crowdList = mCrowdRenderer.streamList(mStreamBuffer, packet.crowdDrawList);
+        if (impostorCount > 0)
+        {
+            impostors = mStreamBuffer.allocate(impostorCount * sizeof(CrowdImpostor));
+            if (impostors.data != NULL)
+                memcpy(impostors.data, &packet.crowdDrawList.impostors[0], impostors.size);
+        }
+    }
+
+    for (int view = 0; view < viewCount; ++view)
+    {
+        const mat4& viewProjection = packet.views[view].viewProjection;
+        if (viewCount > 1)
+            glViewport(packet.views[view].x, packet.views[view].y, packet.views[view].width, packet.views[view].height);
+        mStateCache.bindBufferRange(GL_UNIFORM_BUFFER, 0, mStreamBuffer.buffer(), viewData[view].offset, viewData[view].size);
+
+        // Coord lines and floor grid, the chunks in view
+        mStaticBatch.render(mStateCache, viewProjection, extractFrustum(viewProjection));
+
+        // Draw Olaf
+        if (mMultiDraw)
+            mOlafBatch.render(mStateCache, mStreamBuffer, packet.olafRenderMode);
+        else
+        {
+            mDynamicBatch.render(mStateCache, mStreamBuffer, viewProjection);
+            mRenderQueue.execute(mStateCache, viewProjection);
+        }
+
+        if (drawCrowd && mCrowdRenderer.usesGpuCulling())
+            mCrowdRenderer.render(mStateCache, mStreamBuffer, viewProjection);
+        else if (drawCrowd && !crowdOnePass && !mOptions.crowdDraws)
+            mCrowdRenderer.drawStreamedList(mStateCache, mStreamBuffer, crowdList);
+
+        if (impostorCount > 0)
+            mImpostors.draw(mStateCache, mStreamBuffer, impostors, impostorCount, packet.views[view].viewMatrix);
+    }
+
+    if (crowdOnePass)
+    {
+        GLfloat viewports[SCENE_MAX_VIEWS * 4];
+        for (int view = 0; view < viewCount; ++view)
+        {
+            viewports[view * 4 + 0] = (GLfloat)packet.views[view].x;
+            viewports[view * 4 + 1] = (GLfloat)packet.views[view].y;
+            viewports[view * 4 + 2] = (GLfloat)packet.views[view].width;
+            viewports[view * 4 + 3] = (GLfloat)packet.views[view].height;
+        }
+        glViewportArrayv(0, viewCount, viewports);
+        mStateCache.bindBufferRange(GL_UNIFORM_BUFFER, 0, mStreamBuffer.buffer(), multiViewData.offset, multiViewData.size);
+        mCrowdRenderer.drawStreamedList(mStateCache, mStreamBuffer, crowdList, viewCount);
+    }
+
+    // glViewport resets every viewport of the array too
+    if (viewCount > 1)
+        glViewport(0, 0, packet.framebufferWidth, packet.framebufferHeight);
+
+    // Over the main view, last so nothing draws on top of it
+    if (mMinimap.isCreated())
+    {
+        const FrameView& mainView = packet.views[0];
+        mMinimap.composite(mStateCache, mainView.x, mainView.y, mainView.width, mainView.height);
+        if (viewCount > 1)
+            glViewport(0, 0, packet.framebufferWidth, packet.framebufferHeight);
+    }
+
+    // Fence this third of the stream buffer
+    mStreamBuffer.endFrame();
+
+    if (mOptions.captureInterval > 0 || mRecording)
+    {
+        AllocationScope scope("capture");
+        if (mOptions.captureInterval > 0)
+            mFrameCapture.endFrame(mFramesRendered, mFramesRendered % mOptions.captureInterval == 0, packet.framebufferWidth, packet.framebufferHeight);
+        if (mRecording)
+            mVideoRecorder.endFrame(mFramesRendered, packet.framebufferWidth, packet.framebufferHeight);
+    }
+
+    GLStats::endFrame(packet.dt);
+    mFramesRendered++;
+
+    // No overlay yet, per-frame metrics go in the window title twice a second
+    if (GLStats::isEnabled() && packet.time - mLastSummaryTime > 0.5f)
+    {
+        GLStats::formatSummary(GLStats::lastFrame(), mSummary, sizeof(mSummary));
+        mSummaryChanged = true;
+        mLastSummaryTime = packet.time;
+    }
+
+    if (mOptions.benchmarkFrames > 0 && mFramesRendered >= mOptions.benchmarkFrames && !mBenchmarkDone)
+    {
+        GLStats::writeJson(mOptions.benchmarkJsonPath);
+        std::cout << "Benchmark done, " << mFramesRendered << " frames written to " << mOptions.benchmarkJsonPath << std::endl;
+        mBenchmarkDone = true;
+    }
+
+    // Arrow keys rotate the world, it only reaches the main shader's uniform
+    mStateCache.useProgram(mShaderProgram);
+    mStateCache.uniformMatrix4(mModelViewProjectionLocation, packet.views[0].viewProjection * packet.worldMatrix);
+}
+
+
+bool SceneRenderer::takeSummary(char* buffer, size_t bufferSize)
+{
+    if (!mSummaryChanged)
+        return false;
+
+    snprintf(buffer, bufferSize, "%s", mSummary);
+    mSummaryChanged = false;
+    return true;
+}
@@ -0,0 +1,112 @@
+//
+// COMP 371 Labs Framework
+//
+// Scene rendering from frame packets -- COMP371 Assignment 2
+//
+// Owns every GL object the scene draws with and turns one FramePacket into GL
+// calls. Only the thread the context is current on may call it; it never reads
+// simulation state, so the main thread can fill the next packet meanwhile.
+
+#pragma once
+
+#define GLEW_STATIC 1
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "CrowdRenderer.h"
+#include "DynamicBatch.h"
+#include "FrameCapture.h"
+#include "FramePacer.h"
+#include "ImpostorRenderer.h"
+#include "LodLibrary.h"
+#include "MeshLibrary.h"
+#include "Minimap.h"
+#include "MultiDrawBatch.h"
+#include "RenderQueue.h"
+#include "Shaders.h"
+#include "StaticBatch.h"
+#include "StreamBuffer.h"
+#include "VideoRecorder.h"
+
+struct FramePacket;
+
+
+struct RenderOptions
+{
+    bool glStats;
+    int benchmarkFrames;
+    const char* benchmarkJsonPath;
+    int crowdCount;
+    bool gpuCulling;
+    bool multiDraw;
+    int captureInterval;
+    const char* captureDirectory;
+    const char* goldenDirectory;
+    int tolerance;
+    double tolerancePixels;
+    const char* recordPath;
+    int recordFramesPerSecond;
+    SwapMode swapMode;
+    double frameLimit;          // frames per second, 0 for no limit
+    int viewportCount;          // views per packet, at most SCENE_MAX_VIEWS
+    bool minimap;
+    float impostorDistance;     // CPU culled crowd only, 0 for no impostors
+    int dynamicBatchVertices;   // meshes up to this size are transformed on the CPU and batched, 0 for none
+    bool crowdDraws;            // CPU culled crowd through the render queue, one draw per member instead of instanced
+};
+
+
+class SceneRenderer
+{
+public:
+    SceneRenderer();
+
+    // Needs a current context
+    bool create(const RenderOptions& options);
+
+    // Finishes captures and recording, returns how many captured frames missed their golden image
+    unsigned int destroy();
+
+    // Draws the packet into the back buffer, the caller swaps
+    void renderFrame(const FramePacket& packet);
+
+    // Immutable once created, the simulation reads the mesh bounds from it
+    const MeshLibrary& meshes() const { return mMeshLibrary; }
+    bool usesGpuCulling() const { return mCrowdRenderer.usesGpuCulling(); }
+    bool usesImpostors() const { return mImpostors.isCreated(); }
+
+    // Stats summary for the window title, empty when stats are off. True when it changed since the last call.
+    bool takeSummary(char* buffer, size_t bufferSize);
+
+    // The benchmark frame count was reached and its JSON written
+    bool benchmarkDone() const { return mBenchmarkDone; }
+
+private:
+    RenderOptions mOptions;
+
+    ShaderPermutations mSceneShaders;
+    GLuint mShaderProgram;
+    GLint mModelViewProjectionLocation;
+    GLStateCache mStateCache;
+    StreamBuffer mStreamBuffer;
+    MeshLibrary mMeshLibrary;
+    CrowdRenderer mCrowdRenderer;
+    StaticBatch mStaticBatch;
+    RenderQueue mRenderQueue;
+    DynamicBatch mDynamicBatch;
+    LodLibrary mLodLibrary;
+    bool mMultiDraw;
+    MultiDrawBatch mOlafBatch;
+    Minimap mMinimap;
+    ImpostorRenderer mImpostors;
+    FrameCapture mFrameCapture;
+    VideoRecorder mVideoRecorder;
+    bool mRecording;
+
+    int mFramesRendered;
+    float mLastSummaryTime;
+    char mSummary[200];
+    bool mSummaryChanged;
+    bool mBenchmarkDone;
+};
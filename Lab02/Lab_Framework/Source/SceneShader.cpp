@@ -0,0 +1,96 @@
+//
+// COMP 371 Labs Framework
+//
+// Scene shader permutations -- COMP371 Assignment 2
+
+#include "SceneShader.h"
+
+
+// Preprocessor lines need their newlines, so unlike the other sources every line ends in \n
+static const char* getSceneVertexShaderSource()
+{
+    return
+        "layout (location = 0) in vec3 aPos;\n"
+        "layout (location = 1) in vec3 aColor;\n"
+        "\n"
+        "#if defined(INSTANCE_ATTRIBUTE)\n"
+        "layout (location = 3) in mat3x4 aWorldMatrix;\n"
+        "#elif defined(INSTANCE_STORAGE)\n"
+        "layout (location = 2) in uint aInstanceIndex;\n" // from the visible list, per instance and offset by baseInstance
+        "struct Instance { mat3x4 worldMatrix; vec4 bounds; uint mesh; uint padding0; uint padding1; uint padding2; };\n"
+        "layout (std430, binding = 0) readonly buffer Instances { Instance instances[]; };\n"
+        "#elif defined(DRAW_ID)\n"
+        "struct DrawData { mat3x4 worldMatrix; vec4 material; };\n"
+        "layout (std430, binding = 3) readonly buffer DrawDataBuffer { DrawData drawData[]; };\n"
+        "#else\n"
+        "uniform mat4 modelViewProjection = mat4(1.0);\n" // computed once per draw on the CPU
+        "#endif\n"
+        "\n"
+        "#if defined(MULTI_VIEW)\n"
+        "layout (std140) uniform FrameData\n"
+        "{\n"
+        "   mat4 viewProjectionMatrices[3];\n" // SCENE_MAX_VIEWS
+        "   int viewCount;\n"
+        "};\n"
+        "#elif defined(INSTANCE_ATTRIBUTE) || defined(INSTANCE_STORAGE) || defined(DRAW_ID)\n"
+        "layout (std140) uniform FrameData\n"
+        "{\n"
+        "   mat4 viewProjectionMatrix;\n"
+        "};\n"
+        "#endif\n"
+        "\n"
+        "out vec3 vertexColor;\n"
+        "void main()\n"
+        "{\n"
+        "   vertexColor = aColor;\n"
+        "#if defined(MULTI_VIEW)\n"
+        "   int view = gl_InstanceID % viewCount;\n" // the instance attributes advance every viewCount instances
+        "   gl_ViewportIndex = view;\n"
+        "   mat4 viewProjectionMatrix = viewProjectionMatrices[view];\n"
+        "#endif\n"
+        "#if defined(INSTANCE_ATTRIBUTE)\n"
+        "   gl_Position = viewProjectionMatrix * vec4(vec4(aPos, 1.0) * aWorldMatrix, 1.0);\n"
+        "#elif defined(INSTANCE_STORAGE)\n"
+        "   gl_Position = viewProjectionMatrix * vec4(vec4(aPos, 1.0) * instances[aInstanceIndex].worldMatrix, 1.0);\n"
+        "#elif defined(DRAW_ID)\n"
+        "   DrawData draw = drawData[gl_DrawIDARB];\n"
+        "   vertexColor *= draw.material.rgb;\n"
+        "   gl_Position = viewProjectionMatrix * vec4(vec4(aPos, 1.0) * draw.worldMatrix, 1.0);\n"
+        "#else\n"
+        "   gl_Position = modelViewProjection * vec4(aPos, 1.0);\n"
+        "#endif\n"
+        "}\n";
+}
+
+
+static const char* getSceneFragmentShaderSource()
+{
+    return
+        "in vec3 vertexColor;\n"
+        "out vec4 FragColor;\n"
+        "void main()\n"
+        "{\n"
+        "   FragColor = vec4(vertexColor, 1.0f);\n"
+        "}\n";
+}
+
+
+static const ShaderFeature sSceneShaderFeatures[SCENE_SHADER_FEATURE_COUNT] = {
+    { "INSTANCE_ATTRIBUTE", 330, NULL },
+    { "INSTANCE_STORAGE", 430, NULL },
+    { "DRAW_ID", 430, "GL_ARB_shader_draw_parameters" },
+    { "MULTI_VIEW", 410, "GL_ARB_shader_viewport_layer_array" },
+};
+
+
+bool isMultiViewSupported()
+{
+    return GLEW_VERSION_4_1 && GLEW_ARB_shader_viewport_layer_array;
+}
+
+
+void createSceneShader(ShaderPermutations& shaders)
+{
+    shaders.create("scene", getSceneVertexShaderSource(), getSceneFragmentShaderSource(),
+                   330, sSceneShaderFeatures, SCENE_SHADER_FEATURE_COUNT);
+}
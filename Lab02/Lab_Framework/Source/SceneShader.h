@@ -0,0 +1,33 @@
+//
+// COMP 371 Labs Framework
+//
+// Scene shader permutations -- COMP371 Assignment 2
+//
+// One position + color shader for everything that draws scene meshes. Without
+// features the world comes in as a CPU computed modelViewProjection uniform; the
+// instanced features read the view-projection from the camera block and take the
+// world transform from wherever that path keeps it. Only one of the world sources
+// can be set on a variant.
+
+#pragma once
+
+#include "Shaders.h"
+
+
+enum SceneShaderFeature
+{
+    SCENE_SHADER_INSTANCE_ATTRIBUTE = 1 << 0,   // per instance mat3x4 attribute at locations 3 to 5
+    SCENE_SHADER_INSTANCE_STORAGE   = 1 << 1,   // instance index attribute at location 2 into a storage buffer (GL 4.3)
+    SCENE_SHADER_DRAW_ID            = 1 << 2,   // per draw world and material indexed by gl_DrawIDARB (GL 4.3)
+    SCENE_SHADER_MULTI_VIEW         = 1 << 3,   // with INSTANCE_ATTRIBUTE: instance i draws into viewport i % viewCount (GL 4.1 + ARB_shader_viewport_layer_array)
+
+    SCENE_SHADER_FEATURE_COUNT = 4
+};
+
+// Views the MULTI_VIEW camera block holds, its FrameData is this many view-projections then the view count
+static const int SCENE_MAX_VIEWS = 3;
+
+// Viewport arrays and gl_ViewportIndex from the vertex shader
+bool isMultiViewSupported();
+
+void createSceneShader(ShaderPermutations& shaders);
@@ -0,0 +1,210 @@
+//
+// COMP 371 Labs Framework
+//
+// Shader compile and link helpers -- COMP371 Assignment 2
+
+#include "Shaders.h"
+
+#include <cstdio>
+#include <iostream>
+
+
+static const char* shaderTypeName(GLenum type)
+{
+    switch (type)
+    {
+    case GL_VERTEX_SHADER: return "VERTEX";
+    case GL_FRAGMENT_SHADER: return "FRAGMENT";
+    case GL_COMPUTE_SHADER: return "COMPUTE";
+    default: return "UNKNOWN";
+    }
+}
+
+
+GLuint compileShader(GLenum type, const char* source)
+{
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+
+    // check for shader compile errors
+    int success;
+    char infoLog[512];
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success)
+    {
+        glGetShaderInfoLog(shader, 512, NULL, infoLog);
+        std::cerr << "ERROR::SHADER::" << shaderTypeName(type) << "::COMPILATION_FAILED\n" << infoLog << std::endl;
+        glDeleteShader(shader);
+        return 0;
+    }
+
+    return shader;
+}
+
+
+static GLuint checkLinkStatus(GLuint program)
+{
+    // check for linking errors
+    int success;
+    char infoLog[512];
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        glGetProgramInfoLog(program, 512, NULL, infoLog);
+        std::cerr << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+        glDeleteProgram(program);
+        return 0;
+    }
+
+    return program;
+}
+
+
+GLuint linkProgram(GLuint vertexShader, GLuint fragmentShader)
+{
+    if (vertexShader == 0 || fragmentShader == 0)
+    {
+        glDeleteShader(vertexShader);
+        glDeleteShader(fragmentShader);
+        return 0;
+    }
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertexShader);
+    glAttachShader(program, fragmentShader);
+    glLinkProgram(program);
+
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+
+    program = checkLinkStatus(program);
+    if (program != 0)
+        bindFrameDataBlock(program);
+    return program;
+}
+
+
+GLuint linkComputeProgram(GLuint computeShader)
+{
+    if (computeShader == 0)
+        return 0;
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, computeShader);
+    glLinkProgram(program);
+    glDeleteShader(computeShader);
+
+    return checkLinkStatus(program);
+}
+
+
+void bindFrameDataBlock(GLuint program)
+{
+    GLuint frameDataIndex = glGetUniformBlockIndex(program, "FrameData");
+    if (frameDataIndex != GL_INVALID_INDEX)
+        glUniformBlockBinding(program, frameDataIndex, FRAME_DATA_BINDING);
+}
+
+
+ShaderPermutations::ShaderPermutations()
+    : mName(""), mVertexSource(NULL), mFragmentSource(NULL), mBaseGlslVersion(330), mFeatures(NULL), mFeatureCount(0)
+{
+}
+
+
+ShaderPermutations::~ShaderPermutations()
+{
+    destroy();
+}
+
+
+void ShaderPermutations::create(const char* name, const char* vertexSource, const char* fragmentSource,
+                                int baseGlslVersion, const ShaderFeature* features, int featureCount)
+{
+    destroy();
+    mName = name;
+    mVertexSource = vertexSource;
+    mFragmentSource = fragmentSource;
+    mBaseGlslVersion = baseGlslVersion;
+    mFeatures = features;
+    mFeatureCount = featureCount;
+}
+
+
+void ShaderPermutations::destroy()
+{
+    for (size_t i = 0; i < mVariants.size(); ++i)
+    {
+        if (mVariants[i].program != 0)
+            glDeleteProgram(mVariants[i].program);
+    }
+    mVariants.clear();
+}
+
+
+std::string ShaderPermutations::buildSource(const char* source, unsigned int features) const
+{
+    int version = mBaseGlslVersion;
+    for (int i = 0; i < mFeatureCount; ++i)
+    {
+        if ((features & (1u << i)) && mFeatures[i].glslVersion > version)
+            version = mFeatures[i].glslVersion;
+    }
+
+    char line[128];
+    snprintf(line, sizeof(line), "#version %d core\n", version);
+    std::string result = line;
+
+    for (int i = 0; i < mFeatureCount; ++i)
+    {
+        if (!(features & (1u << i)))
+            continue;
+        if (mFeatures[i].extension != NULL)
+            result += std::string("#extension ") + mFeatures[i].extension + " : require\n";
+        result += std::string("#define ") + mFeatures[i].define + " 1\n";
+    }
+
+    // keep compiler messages on the base source's line numbers
+    result += "#line 1\n";
+    result += source;
+    return result;
+}
+
+
+GLuint ShaderPermutations::program(unsigned int features)
+{
+    // a handful of variants per source, a linear search is fine
+    for (size_t i = 0; i < mVariants.size(); ++i)
+    {
+        if (mVariants[i].features == features)
+            return mVariants[i].program;
+    }
+
+    Variant variant;
+    variant.features = features;
+    variant.program = 0;
+
+    if ((features >> mFeatureCount) != 0)
+    {
+        std::cerr << "ShaderPermutations: " << mName << " has no feature bits 0x" << std::hex << (features >> mFeatureCount << mFeatureCount) << std::dec << std::endl;
+    }
+    else
+    {
+        std::string vertexSource = buildSource(mVertexSource, features);
+        std::string fragmentSource = buildSource(mFragmentSource, features);
+        variant.program = linkProgram(compileShader(GL_VERTEX_SHADER, vertexSource.c_str()),
+                                      compileShader(GL_FRAGMENT_SHADER, fragmentSource.c_str()));
+        if (variant.program == 0)
+            std::cerr << "ShaderPermutations: " << mName << " variant 0x" << std::hex << features << std::dec << " failed" << std::endl;
+    }
+
+    mVariants.push_back(variant);
+    return variant.program;
+}
+
+
+void ShaderPermutations::precompile(const unsigned int* featureSets, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+        program(featureSets[i]);
+}
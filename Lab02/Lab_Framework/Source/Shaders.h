@@ -0,0 +1,79 @@
+//
+// COMP 371 Labs Framework
+//
+// Shader compile and link helpers -- COMP371 Assignment 2
+//
+// Same steps as compileAndLinkShaders from the lab, split up so every program
+// (main, instanced, compute) goes through them. Errors are printed to cerr.
+//
+// ShaderPermutations builds variants of one vertex/fragment source pair. The sources
+// have no #version line; each variant gets the highest version its features need,
+// their extensions, and a #define per feature bit, and is compiled the first time
+// that bitmask is asked for. Variants nobody asks for are never compiled.
+
+#pragma once
+
+#define GLEW_STATIC 1
+#include <GL/glew.h>
+
+#include <string>
+#include <vector>
+
+
+// Returns the shader id, 0 if compilation failed
+GLuint compileShader(GLenum type, const char* source);
+
+// Links and deletes the shaders, returns the program id, 0 if linking failed
+GLuint linkProgram(GLuint vertexShader, GLuint fragmentShader);
+GLuint linkComputeProgram(GLuint computeShader);
+
+// Programs that read the per-frame camera block (FrameData, the view-projection) get it from binding point 0
+static const GLuint FRAME_DATA_BINDING = 0;
+void bindFrameDataBlock(GLuint program);
+
+
+struct ShaderFeature
+{
+    const char* define;         // #define NAME 1 when the feature bit is set
+    int glslVersion;            // minimum #version the feature needs
+    const char* extension;      // #extension ... : require, or NULL
+};
+
+
+class ShaderPermutations
+{
+public:
+    ShaderPermutations();
+    ~ShaderPermutations();
+
+    // features[i] is bit (1 << i) of a variant key, the table has to outlive this object
+    void create(const char* name, const char* vertexSource, const char* fragmentSource,
+                int baseGlslVersion, const ShaderFeature* features, int featureCount);
+    void destroy();
+
+    // Compiles the variant on first use, then returns the cached program; 0 if it failed
+    // (failures are cached too so they are only reported once)
+    GLuint program(unsigned int features);
+
+    // Compiles a declared set of variants up front so none of them hitch later
+    void precompile(const unsigned int* featureSets, size_t count);
+
+    size_t variantCount() const { return mVariants.size(); }
+
+private:
+    struct Variant
+    {
+        unsigned int features;
+        GLuint program;
+    };
+
+    std::string buildSource(const char* source, unsigned int features) const;
+
+    const char* mName;
+    const char* mVertexSource;
+    const char* mFragmentSource;
+    int mBaseGlslVersion;
+    const ShaderFeature* mFeatures;
+    int mFeatureCount;
+    std::vector<Variant> mVariants;
+};
@@ -0,0 +1,58 @@
+//
+// COMP 371 Labs Framework
+//
+// Lock-free single producer, single consumer queue -- COMP371 Assignment 2
+//
+// A fixed ring of Capacity items between exactly two threads: one only pushes, the
+// other only pops. Each side owns one index and only reads the other's, so there
+// are no locks and no allocations; the release store of an index publishes the
+// item written before it. push() and pop() never wait, they return false when the
+// queue is full or empty and the caller decides how to back off.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+
+template <typename T, size_t Capacity>
+class SpscQueue
+{
+public:
+    SpscQueue() : mHead(0), mTail(0) {}
+
+    // Producer thread only
+    bool push(const T& item)
+    {
+        size_t tail = mTail.load(std::memory_order_relaxed);
+        size_t next = (tail + 1) % Slots;
+        if (next == mHead.load(std::memory_order_acquire))
+            return false;
+
+        mItems[tail] = item;
+        mTail.store(next, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer thread only
+    bool pop(T& item)
+    {
+        size_t head = mHead.load(std::memory_order_relaxed);
+        if (head == mTail.load(std::memory_order_acquire))
+            return false;
+
+        item = mItems[head];
+        mHead.store((head + 1) % Slots, std::memory_order_release);
+        return true;
+    }
+
+private:
+    // one slot stays empty so a full ring can be told apart from an empty one
+    static const size_t Slots = Capacity + 1;
+
+    T mItems[Slots];
+
+    // on their own cache lines, each is written by one thread and read by the other
+    alignas(64) std::atomic<size_t> mHead;
+    alignas(64) std::atomic<size_t> mTail;
+};
@@ -0,0 +1,314 @@
+//
+// COMP 371 Labs Framework
+//
+// Static batching -- COMP371 Assignment 2
+
+#include "StaticBatch.h"
+#include "Frustum.h"
+#include "GLStats.h"
+#include "RenderQueue.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <map>
+
+using namespace glm;
+
+
+// Exact duplicates only, chunks share the vertices their primitives have in common
+struct MeshVertexLess
+{
+    bool operator()(const MeshVertex& a, const MeshVertex& b) const
+    {
+        return memcmp(&a, &b, sizeof(MeshVertex)) < 0;
+    }
+};
+
+
+struct ChunkedPrimitive
+{
+    int cellX;
+    int cellY;
+    size_t primitive;
+
+    bool operator<(const ChunkedPrimitive& other) const
+    {
+        if (cellY != other.cellY)
+            return cellY < other.cellY;
+        if (cellX != other.cellX)
+            return cellX < other.cellX;
+        return primitive < other.primitive;
+    }
+};
+
+
+static MeshVertex lerpVertex(const MeshVertex& a, const MeshVertex& b, float t)
+{
+    MeshVertex vertex;
+    vertex.position = mix(a.position, b.position, t);
+    vertex.color = mix(a.color, b.color, t);
+    return vertex;
+}
+
+
+// Cuts every line where it crosses a chunk border in x or y, so each piece lies in one chunk
+static void splitLines(const std::vector<MeshVertex>& lines, float chunkSize, std::vector<MeshVertex>& pieces)
+{
+    std::vector<float> cuts;
+    for (size_t i = 0; i + 1 < lines.size(); i += 2)
+    {
+        const MeshVertex& a = lines[i];
+        const MeshVertex& b = lines[i + 1];
+
+        cuts.clear();
+        cuts.push_back(0.0f);
+        cuts.push_back(1.0f);
+        for (int axis = 0; axis < 2; ++axis)
+        {
+            float delta = b.position[axis] - a.position[axis];
+            if (delta == 0.0f)
+                continue;
+
+            float low = std::min(a.position[axis], b.position[axis]);
+            float high = std::max(a.position[axis], b.position[axis]);
+            for (float border = ceilf(low / chunkSize) * chunkSize; border < high; border += chunkSize)
+            {
+                float t = (border - a.position[axis]) / delta;
+                if (t > 0.0f && t < 1.0f)
+                    cuts.push_back(t);
+            }
+        }
+        std::sort(cuts.begin(), cuts.end());
+
+        for (size_t cut = 0; cut + 1 < cuts.size(); ++cut)
+        {
+            if (cuts[cut + 1] - cuts[cut] < 1e-6f)
+                continue;
+            pieces.push_back(lerpVertex(a, b, cuts[cut]));
+            pieces.push_back(lerpVertex(a, b, cuts[cut + 1]));
+        }
+    }
+}
+
+
+StaticBatch::StaticBatch()
+    : mProgram(0), mModelViewProjectionLocation(-1), mVertexArray(0), mVertexBuffer(0), mIndexBuffer(0), mLastDrawCount(0)
+{
+}
+
+
+StaticBatch::~StaticBatch()
+{
+    destroy();
+}
+
+
+void StaticBatch::create(GLuint program, GLint modelViewProjectionLocation)
+{
+    destroy();
+    mProgram = program;
+    mModelViewProjectionLocation = modelViewProjectionLocation;
+}
+
+
+void StaticBatch::destroy()
+{
+    if (mVertexArray != 0)
+        glDeleteVertexArrays(1, &mVertexArray);
+    if (mVertexBuffer != 0)
+        glDeleteBuffers(1, &mVertexBuffer);
+    if (mIndexBuffer != 0)
+        glDeleteBuffers(1, &mIndexBuffer);
+    mVertexArray = 0;
+    mVertexBuffer = 0;
+    mIndexBuffer = 0;
+    mGroups.clear();
+    mChunks.clear();
+}
+
+
+bool StaticBatch::add(const MeshLibrary& meshes, MeshId meshId, const Affine3x4& worldMatrix, unsigned int material, unsigned int renderState)
+{
+    const Mesh& mesh = meshes.mesh(meshId);
+    if (mesh.mode != GL_LINES && mesh.mode != GL_TRIANGLES)
+    {
+        std::cerr << "StaticBatch: mesh " << meshId << " is neither lines nor triangles" << std::endl;
+        return false;
+    }
+    if (isBuilt())
+    {
+        std::cerr << "StaticBatch: already built" << std::endl;
+        return false;
+    }
+
+    Group* group = NULL;
+    for (size_t i = 0; i < mGroups.size() && group == NULL; ++i)
+    {
+        if (mGroups[i].material == material && mGroups[i].mode == mesh.mode && mGroups[i].renderState == renderState)
+            group = &mGroups[i];
+    }
+    if (group == NULL)
+    {
+        mGroups.push_back(Group());
+        group = &mGroups.back();
+        group->material = material;
+        group->mode = mesh.mode;
+        group->renderState = renderState;
+        group->firstChunk = 0;
+        group->chunkCount = 0;
+    }
+
+    const std::vector<MeshVertex>& vertices = meshes.vertices();
+    const std::vector<GLuint>& indices = meshes.indices();
+    for (GLsizei i = 0; i < mesh.indexCount; ++i)
+    {
+        MeshVertex vertex = vertices[mesh.baseVertex + indices[mesh.firstIndex + i]];
+        vertex.position = transformPoint(worldMatrix, vertex.position);
+        group->vertices.push_back(vertex);
+    }
+    return true;
+}
+
+
+bool StaticBatch::build(float chunkSize)
+{
+    std::vector<MeshVertex> vertices;
+    std::vector<GLuint> indices;
+    std::map<MeshVertex, GLuint, MeshVertexLess> welded;
+    std::vector<ChunkedPrimitive> order;
+    mChunks.clear();
+
+    // Groups stay in the order they were added, which is the order they draw in
+    for (size_t g = 0; g < mGroups.size(); ++g)
+    {
+        Group& group = mGroups[g];
+        const size_t cornerCount = group.mode == GL_LINES ? 2 : 3;
+
+        std::vector<MeshVertex> primitives;
+        if (group.mode == GL_LINES)
+            splitLines(group.vertices, chunkSize, primitives);
+        else
+            primitives.swap(group.vertices);
+        std::vector<MeshVertex>().swap(group.vertices);
+
+        const size_t primitiveCount = primitives.size() / cornerCount;
+        order.resize(primitiveCount);
+        for (size_t p = 0; p < primitiveCount; ++p)
+        {
+            vec3 center(0.0f);
+            for (size_t corner = 0; corner < cornerCount; ++corner)
+                center += primitives[p * cornerCount + corner].position;
+            center /= (float)cornerCount;
+
+            order[p].cellX = (int)floorf(center.x / chunkSize);
+            order[p].cellY = (int)floorf(center.y / chunkSize);
+            order[p].primitive = p;
+        }
+        std::sort(order.begin(), order.end());
+
+        group.firstChunk = mChunks.size();
+        for (size_t begin = 0; begin < primitiveCount; )
+        {
+            size_t end = begin + 1;
+            while (end < primitiveCount && order[end].cellX == order[begin].cellX && order[end].cellY == order[begin].cellY)
+                ++end;
+
+            Chunk chunk;
+            chunk.firstIndex = (GLuint)indices.size();
+            vec3 minimum(FLT_MAX);
+            vec3 maximum(-FLT_MAX);
+
+            welded.clear();
+            for (size_t i = begin; i < end; ++i)
+            {
+                for (size_t corner = 0; corner < cornerCount; ++corner)
+                {
+                    const MeshVertex& vertex = primitives[order[i].primitive * cornerCount + corner];
+                    std::map<MeshVertex, GLuint, MeshVertexLess>::iterator found = welded.find(vertex);
+                    if (found == welded.end())
+                    {
+                        found = welded.insert(std::make_pair(vertex, (GLuint)vertices.size())).first;
+                        vertices.push_back(vertex);
+                        minimum = min(minimum, vertex.position);
+                        maximum = max(maximum, vertex.position);
+                    }
+                    indices.push_back(found->second);
+                }
+            }
+
+            chunk.indexCount = (GLsizei)(indices.size() - chunk.firstIndex);
+            chunk.boundsCenter = (minimum + maximum) * 0.5f;
+            chunk.boundsRadius = length(maximum - minimum) * 0.5f;
+            mChunks.push_back(chunk);
+            begin = end;
+        }
+        group.chunkCount = mChunks.size() - group.firstChunk;
+    }
+
+    if (indices.empty())
+    {
+        std::cerr << "StaticBatch: nothing to build" << std::endl;
+        return false;
+    }
+
+    glGenVertexArrays(1, &mVertexArray);
+    glBindVertexArray(mVertexArray);
+
+    glGenBuffers(1, &mVertexBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, mVertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(MeshVertex), &vertices[0], GL_STATIC_DRAW);
+
+    glGenBuffers(1, &mIndexBuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mIndexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), &indices[0], GL_STATIC_DRAW);
+
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void*)sizeof(vec3));
+    glEnableVertexAttribArray(1);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return true;
+}
+
+
+void StaticBatch::render(GLStateCache& stateCache, const mat4& viewProjection, const Frustum& frustum)
+{
+    mLastDrawCount = 0;
+    if (mVertexArray == 0)
+        return;
+
+    stateCache.useProgram(mProgram);
+    stateCache.uniformMatrix4(mModelViewProjectionLocation, viewProjection);
+    stateCache.bindVertexArray(mVertexArray);
+
+    for (size_t g = 0; g < mGroups.size(); ++g)
+    {
+        const Group& group = mGroups[g];
+        stateCache.setRenderState(group.renderState);
+
+        // Visible neighbours are neighbours in the index buffer too, a run is one draw
+        GLuint runFirst = 0;
+        GLsizei runCount = 0;
+        for (size_t c = group.firstChunk; c <= group.firstChunk + group.chunkCount; ++c)
+        {
+            bool visible = c < group.firstChunk + group.chunkCount && sphereInFrustum(frustum, mChunks[c].boundsCenter, mChunks[c].boundsRadius);
+            if (visible)
+            {
+                if (runCount == 0)
+                    runFirst = mChunks[c].firstIndex;
+                runCount += mChunks[c].indexCount;
+            }
+            else if (runCount > 0)
+            {
+                statsDrawElements(group.mode, runCount, GL_UNSIGNED_INT, (void*)((size_t)runFirst * sizeof(GLuint)));
+                mLastDrawCount++;
+                runCount = 0;
+            }
+        }
+    }
+}
@@ -0,0 +1,88 @@
+//
+// COMP 371 Labs Framework
+//
+// Static batching -- COMP371 Assignment 2
+//
+// Geometry that never moves (the floor grid, the coordinate axes, static props) is
+// baked once at load time instead of being drawn mesh by mesh with its own world
+// matrix. add() transforms a mesh's vertices into world space right away; build()
+// groups everything by material, primitive mode and render state, cuts each group
+// into square chunks on the ground so chunks can be culled, and uploads the result
+// into one vertex and one index buffer. Lines crossing a chunk border are split at
+// it, triangles go to the chunk their centroid falls in.
+//
+// A group's chunks are consecutive in the index buffer, so render() draws each run
+// of visible chunks with a single glDrawElements: the whole grid is one to a few
+// draws instead of two hundred. Vertices are in world space, the shader only needs
+// the view-projection.
+
+#pragma once
+
+#define GLEW_STATIC 1
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "Affine.h"
+#include "MeshLibrary.h"
+
+class GLStateCache;
+struct Frustum;
+
+
+class StaticBatch
+{
+public:
+    StaticBatch();
+    ~StaticBatch();
+
+    // Draws with program, which takes the view-projection in modelViewProjectionLocation
+    void create(GLuint program, GLint modelViewProjectionLocation);
+    void destroy();
+
+    // Pre-transforms the mesh into world space. Only GL_LINES and GL_TRIANGLES meshes batch.
+    bool add(const MeshLibrary& meshes, MeshId mesh, const Affine3x4& worldMatrix, unsigned int material, unsigned int renderState);
+
+    // Chunks and uploads everything added so far, the CPU copies are freed
+    bool build(float chunkSize);
+
+    // Draws the chunks inside the frustum, one draw per run of consecutive visible chunks
+    void render(GLStateCache& stateCache, const glm::mat4& viewProjection, const Frustum& frustum);
+
+    bool isBuilt() const { return mVertexArray != 0; }
+    size_t chunkCount() const { return mChunks.size(); }
+
+    // Draws issued by the last render()
+    unsigned int lastDrawCount() const { return mLastDrawCount; }
+
+private:
+    // Everything that shares a material, mode and render state
+    struct Group
+    {
+        unsigned int material;
+        GLenum mode;
+        unsigned int renderState;
+        std::vector<MeshVertex> vertices;     // world space primitives, freed by build()
+        size_t firstChunk;
+        size_t chunkCount;
+    };
+
+    struct Chunk
+    {
+        GLuint firstIndex;
+        GLsizei indexCount;
+        glm::vec3 boundsCenter;
+        float boundsRadius;
+    };
+
+    GLuint mProgram;
+    GLint mModelViewProjectionLocation;
+    std::vector<Group> mGroups;
+    std::vector<Chunk> mChunks;
+    GLuint mVertexArray;
+    GLuint mVertexBuffer;
+    GLuint mIndexBuffer;
+    unsigned int mLastDrawCount;
+};
@@ -0,0 +1,224 @@
+//
+// COMP 371 Labs Framework
+//
+// Streaming buffer for per-frame data -- COMP371 Assignment 2
+
+#include "StreamBuffer.h"
+#include "GLStats.h"
+
+#include <iostream>
+#include <cstring>
+
+
+static GLsizeiptr alignUp(GLsizeiptr value, GLsizeiptr alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+
+StreamBuffer::StreamBuffer()
+    : mBuffer(0), mPersistent(false), mFrameSize(0), mUniformAlignment(256), mStorageAlignment(256),
+      mMapped(NULL), mRegion(0), mHead(0), mFlushed(0)
+{
+    for (int i = 0; i < FrameCount; ++i)
+        mFences[i] = 0;
+}
+
+
+StreamBuffer::~StreamBuffer()
+{
+    destroy();
+}
+
+
+bool StreamBuffer::create(GLsizeiptr frameSize)
+{
+    destroy();
+
+    GLint uniformAlignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+    mUniformAlignment = uniformAlignment > 0 ? uniformAlignment : 256;
+
+    // storage blocks only exist on 4.3 contexts
+    GLint storageAlignment = 256;
+    if (GLEW_VERSION_4_3)
+        glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storageAlignment);
+    mStorageAlignment = storageAlignment > 0 ? storageAlignment : 256;
+
+    // every region has to start on an alignment any allocation could ask for
+    GLsizeiptr regionAlignment = 256;
+    if (mUniformAlignment > regionAlignment)
+        regionAlignment = mUniformAlignment;
+    if (mStorageAlignment > regionAlignment)
+        regionAlignment = mStorageAlignment;
+    mFrameSize = alignUp(frameSize, regionAlignment);
+    mPersistent = GLEW_ARB_buffer_storage != 0;
+
+    glGenBuffers(1, &mBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, mBuffer);
+
+    if (mPersistent)
+    {
+        // map once and keep the pointer for the lifetime of the buffer
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_COPY_WRITE_BUFFER, mFrameSize * FrameCount, NULL, flags);
+        mMapped = (unsigned char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, mFrameSize * FrameCount, flags);
+
+        if (mMapped == NULL)
+        {
+            std::cerr << "StreamBuffer: persistent mapping failed, falling back to orphaning" << std::endl;
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+            glDeleteBuffers(1, &mBuffer);
+            glGenBuffers(1, &mBuffer);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, mBuffer);
+            mPersistent = false;
+        }
+    }
+
+    if (!mPersistent)
+    {
+        glBufferData(GL_COPY_WRITE_BUFFER, mFrameSize, NULL, GL_STREAM_DRAW);
+        mStaging.resize(mFrameSize);
+    }
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    mRegion = 0;
+    mHead = 0;
+    mFlushed = 0;
+    return true;
+}
+
+
+void StreamBuffer::destroy()
+{
+    for (int i = 0; i < FrameCount; ++i)
+    {
+        if (mFences[i] != 0)
+            glDeleteSync(mFences[i]);
+        mFences[i] = 0;
+    }
+
+    if (mBuffer != 0)
+    {
+        if (mMapped != NULL)
+        {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, mBuffer);
+            glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        }
+        glDeleteBuffers(1, &mBuffer);
+    }
+
+    mBuffer = 0;
+    mMapped = NULL;
+    mStaging.clear();
+}
+
+
+void StreamBuffer::beginFrame()
+{
+    mRegion = (mRegion + 1) % FrameCount;
+    mHead = 0;
+    mFlushed = 0;
+
+    if (mPersistent)
+    {
+        // the GPU may still be reading this third from three frames ago
+        GLsync fence = mFences[mRegion];
+        if (fence != 0)
+        {
+            GLenum result = glClientWaitSync(fence, 0, 0);
+            while (result == GL_TIMEOUT_EXPIRED)
+                result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1ms
+
+            if (result == GL_WAIT_FAILED)
+                std::cerr << "StreamBuffer: glClientWaitSync failed" << std::endl;
+
+            glDeleteSync(fence);
+            mFences[mRegion] = 0;
+        }
+    }
+    else
+    {
+        // orphan the storage, the driver hands us a fresh block if the old one is in use
+        statsBindBuffer(GL_COPY_WRITE_BUFFER, mBuffer);
+        statsBufferData(GL_COPY_WRITE_BUFFER, mFrameSize, NULL, GL_STREAM_DRAW);
+        statsBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+}
+
+
+StreamAllocation StreamBuffer::allocate(GLsizeiptr size, GLsizeiptr alignment)
+{
+    StreamAllocation allocation;
+    allocation.data = NULL;
+    allocation.offset = 0;
+    allocation.size = 0;
+
+    // nothing to write, and at the end of the region there is no byte to point at
+    if (size == 0)
+        return allocation;
+
+    GLsizeiptr start = alignUp(mHead, alignment);
+    if (start + size > mFrameSize)
+    {
+        std::cerr << "StreamBuffer: out of space (" << mFrameSize << " bytes per frame)" << std::endl;
+        return allocation;
+    }
+
+    mHead = start + size;
+
+    if (mPersistent)
+    {
+        allocation.offset = mRegion * mFrameSize + start;
+        allocation.data = mMapped + allocation.offset;
+    }
+    else
+    {
+        allocation.offset = start;
+        allocation.data = &mStaging[start];
+    }
+    allocation.size = size;
+
+    return allocation;
+}
+
+
+void StreamBuffer::flush()
+{
+    if (mPersistent || mHead == mFlushed)
+        return;
+
+    // coherent mapping makes writes visible on its own, the fallback uploads the new bytes.
+    // Draws of this frame may already read the bytes before mFlushed, so glBufferSubData
+    // could make the driver wait for them; the new range was orphaned at beginFrame() and
+    // nothing reads it yet, so it is mapped unsynchronized instead.
+    const GLsizeiptr size = mHead - mFlushed;
+    statsBindBuffer(GL_COPY_WRITE_BUFFER, mBuffer);
+    void* range = statsMapBufferRange(GL_COPY_WRITE_BUFFER, mFlushed, size,
+                                      GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    if (range != NULL)
+    {
+        memcpy(range, &mStaging[mFlushed], size);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    }
+    else
+        statsBufferSubData(GL_COPY_WRITE_BUFFER, mFlushed, size, &mStaging[mFlushed]);
+    statsBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    mFlushed = mHead;
+}
+
+
+void StreamBuffer::endFrame()
+{
+    flush();
+
+    if (mPersistent)
+    {
+        if (mFences[mRegion] != 0)
+            glDeleteSync(mFences[mRegion]);
+        mFences[mRegion] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+}
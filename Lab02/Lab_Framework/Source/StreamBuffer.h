@@ -0,0 +1,80 @@
+//
+// COMP 371 Labs Framework
+//
+// Streaming buffer for per-frame data -- COMP371 Assignment 2
+//
+// One large GL buffer split in three regions, one per frame in flight. The buffer
+// is mapped once (persistent + coherent) when ARB_buffer_storage is available, and
+// every region is fenced at the end of its frame so the CPU never writes over data
+// the GPU is still reading. Without buffer storage we fall back to orphaning the
+// buffer at the start of every frame and copying what was written at each flush
+// into an unsynchronized mapping of just the new range, which no draw has read yet.
+
+#pragma once
+
+#define GLEW_STATIC 1
+#include <GL/glew.h>
+
+#include <vector>
+
+
+struct StreamAllocation
+{
+    void* data;         // CPU pointer to write to
+    GLintptr offset;    // byte offset in the buffer, for glBindBufferRange / attribute pointers
+    GLsizeiptr size;
+};
+
+
+class StreamBuffer
+{
+public:
+    static const int FrameCount = 3;
+
+    StreamBuffer();
+    ~StreamBuffer();
+
+    // frameSize is the number of bytes usable by a single frame
+    bool create(GLsizeiptr frameSize);
+    void destroy();
+
+    // Waits for the region we are about to reuse, call once before any allocate()
+    void beginFrame();
+
+    // Returns an aligned sub-allocation inside the current frame's region.
+    // data is NULL if the region is full or size is 0.
+    StreamAllocation allocate(GLsizeiptr size, GLsizeiptr alignment = 16);
+
+    // Typed helper for uniform blocks, aligned to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+    StreamAllocation allocateUniform(GLsizeiptr size) { return allocate(size, mUniformAlignment); }
+
+    // Same for shader storage blocks, aligned to GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT
+    StreamAllocation allocateStorage(GLsizeiptr size) { return allocate(size, mStorageAlignment); }
+
+    // Makes everything written since the last flush visible to GL. Needs to be called
+    // before a draw sources data from the buffer (no-op when persistently mapped).
+    void flush();
+
+    // Fences the current region
+    void endFrame();
+
+    GLuint buffer() const { return mBuffer; }
+    bool isPersistent() const { return mPersistent; }
+    GLsizeiptr frameSize() const { return mFrameSize; }
+    GLsizeiptr bytesUsed() const { return mHead; }
+
+private:
+    GLuint mBuffer;
+    bool mPersistent;
+    GLsizeiptr mFrameSize;
+    GLsizeiptr mUniformAlignment;
+    GLsizeiptr mStorageAlignment;
+
+    unsigned char* mMapped;              // whole buffer when persistent
+    std::vector<unsigned char> mStaging; // one region worth of CPU memory for the fallback
+
+    int mRegion;
+    GLsizeiptr mHead;
+    GLsizeiptr mFlushed;
+    GLsync mFences[FrameCount];
+};
@@ -0,0 +1,233 @@
+//
+// COMP 371 Labs Framework
+//
+// Frame task graph -- COMP371 Assignment 2
+
+#include "TaskGraph.h"
+
+#include <cstdio>
+#include <iostream>
+#include <thread>
+
+
+TaskGraph::TaskGraph()
+    : mJobs(NULL)
+    , mTasksLeft(0)
+{
+}
+
+
+TaskResource TaskGraph::addResource(const char* name)
+{
+    mResources.push_back(name);
+    return (TaskResource)mResources.size() - 1;
+}
+
+
+TaskId TaskGraph::addTask(const char* name, const std::function<void()>& function)
+{
+    std::function<void()> single = function;
+    return addTask(name, [single](size_t, size_t) { single(); }, 1, 1);
+}
+
+
+TaskId TaskGraph::addTask(const char* name, const RangeFunction& function, size_t count, size_t grain)
+{
+    mTasks.emplace_back();
+    Task& task = mTasks.back();
+    task.graph = this;
+    task.id = (TaskId)mTasks.size() - 1;
+    task.name = name;
+    task.function = function;
+    task.count = count;
+    task.grain = grain > 0 ? grain : 1;
+    task.predecessorCount = 0;
+    task.waitingOn = 0;
+    task.chunksLeft = 0;
+    return task.id;
+}
+
+
+void TaskGraph::reads(TaskId task, TaskResource resource)
+{
+    mTasks[task].reads.push_back(resource);
+}
+
+
+void TaskGraph::writes(TaskId task, TaskResource resource)
+{
+    mTasks[task].writes.push_back(resource);
+}
+
+
+void TaskGraph::setRange(TaskId task, size_t count)
+{
+    mTasks[task].count = count;
+}
+
+
+void TaskGraph::addDependency(TaskId from, TaskId to, TaskResource resource)
+{
+    if (from == to)
+        return;
+
+    Task& predecessor = mTasks[from];
+    for (size_t i = 0; i < predecessor.successors.size(); ++i)
+    {
+        if (predecessor.successors[i] == to)
+            return;
+    }
+
+    predecessor.successors.push_back(to);
+    predecessor.successorResources.push_back(resource);
+    mTasks[to].predecessorCount++;
+}
+
+
+void TaskGraph::compile()
+{
+    for (size_t i = 0; i < mTasks.size(); ++i)
+    {
+        mTasks[i].successors.clear();
+        mTasks[i].successorResources.clear();
+        mTasks[i].predecessorCount = 0;
+    }
+
+    // walk the tasks in the order they were added, like the fixed sequence they replace
+    std::vector<TaskId> lastWriter(mResources.size(), -1);
+    std::vector<std::vector<TaskId>> readersSinceWrite(mResources.size());
+    for (TaskId id = 0; id < (TaskId)mTasks.size(); ++id)
+    {
+        const Task& task = mTasks[id];
+
+        // read after write
+        for (size_t i = 0; i < task.reads.size(); ++i)
+        {
+            TaskResource resource = task.reads[i];
+            if (lastWriter[resource] >= 0)
+                addDependency(lastWriter[resource], id, resource);
+        }
+
+        // write after write, and write after read
+        for (size_t i = 0; i < task.writes.size(); ++i)
+        {
+            TaskResource resource = task.writes[i];
+            if (lastWriter[resource] >= 0)
+                addDependency(lastWriter[resource], id, resource);
+            for (size_t j = 0; j < readersSinceWrite[resource].size(); ++j)
+                addDependency(readersSinceWrite[resource][j], id, resource);
+        }
+
+        for (size_t i = 0; i < task.reads.size(); ++i)
+            readersSinceWrite[task.reads[i]].push_back(id);
+        for (size_t i = 0; i < task.writes.size(); ++i)
+        {
+            lastWriter[task.writes[i]] = id;
+            readersSinceWrite[task.writes[i]].clear();
+        }
+    }
+}
+
+
+void TaskGraph::run(JobSystem& jobs)
+{
+    if (mTasks.empty())
+        return;
+
+    mJobs = &jobs;
+    jobs.beginFrame();
+    mTasksLeft.store((int)mTasks.size());
+    for (size_t i = 0; i < mTasks.size(); ++i)
+        mTasks[i].waitingOn.store(mTasks[i].predecessorCount);
+
+    for (TaskId id = 0; id < (TaskId)mTasks.size(); ++id)
+    {
+        if (mTasks[id].predecessorCount == 0)
+            release(id);
+    }
+
+    while (mTasksLeft.load(std::memory_order_acquire) > 0)
+    {
+        if (!jobs.runOne())
+            std::this_thread::yield();
+    }
+}
+
+
+void TaskGraph::release(TaskId id)
+{
+    Task& task = mTasks[id];
+    size_t chunkCount = (task.count + task.grain - 1) / task.grain;
+    if (chunkCount == 0)
+    {
+        completeTask(id);
+        return;
+    }
+
+    task.chunksLeft.store(chunkCount);
+    for (size_t chunk = 0; chunk < chunkCount; ++chunk)
+    {
+        Job job = { &TaskGraph::runChunk, &task, chunk };
+        mJobs->push(job);
+    }
+}
+
+
+void TaskGraph::runChunk(void* data, size_t index)
+{
+    Task& task = *(Task*)data;
+    size_t begin = index * task.grain;
+    size_t end = begin + task.grain < task.count ? begin + task.grain : task.count;
+    task.function(begin, end);
+
+    if (task.chunksLeft.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        task.graph->completeTask(task.id);
+}
+
+
+void TaskGraph::completeTask(TaskId id)
+{
+    Task& task = mTasks[id];
+    for (size_t i = 0; i < task.successors.size(); ++i)
+    {
+        TaskId successor = task.successors[i];
+        if (mTasks[successor].waitingOn.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            release(successor);
+    }
+    mTasksLeft.fetch_sub(1, std::memory_order_release);
+}
+
+
+bool TaskGraph::writeDot(const char* path) const
+{
+    FILE* file = fopen(path, "w");
+    if (file == NULL)
+    {
+        std::cerr << "TaskGraph: could not open " << path << " for writing" << std::endl;
+        return false;
+    }
+
+    fprintf(file, "digraph frame\n{\n    rankdir=LR;\n    node [shape=box];\n");
+    for (size_t i = 0; i < mTasks.size(); ++i)
+    {
+        const Task& task = mTasks[i];
+        if (task.count > 1)
+            fprintf(file, "    task%u [label=\"%s\\n%u items, chunks of %u\"];\n", (unsigned int)i, task.name,
+                    (unsigned int)task.count, (unsigned int)task.grain);
+        else
+            fprintf(file, "    task%u [label=\"%s\"];\n", (unsigned int)i, task.name);
+    }
+    for (size_t i = 0; i < mTasks.size(); ++i)
+    {
+        const Task& task = mTasks[i];
+        for (size_t j = 0; j < task.successors.size(); ++j)
+        {
+            fprintf(file, "    task%u -> task%u [label=\"%s\"];\n", (unsigned int)i, (unsigned int)task.successors[j],
+                    mResources[task.successorResources[j]]);
+        }
+    }
+    fprintf(file, "}\n");
+
+    fclose(file);
+    return true;
+}
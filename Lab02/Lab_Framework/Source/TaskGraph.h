@@ -0,0 +1,96 @@
+//
+// COMP 371 Labs Framework
+//
+// Frame task graph -- COMP371 Assignment 2
+//
+// The CPU side of a frame as stages that declare the resources they read and
+// write instead of running in a fixed order. compile() turns the declarations into
+// dependencies, in the order the tasks were added: a task runs after the last
+// writer of everything it reads or writes, and a writer also after the readers of
+// the previous value. run() then releases each task to the job system as soon as
+// its dependencies are done, so stages that share nothing run side by side, and a
+// task over a range of items is split into chunks that run on every core.
+// Build the graph once, tasks capture whatever per-frame state they need by
+// reference; running it does not allocate. writeDot() exports it for Graphviz.
+
+#pragma once
+
+#include "JobSystem.h"
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <vector>
+
+
+typedef int TaskId;
+typedef int TaskResource;
+
+
+class TaskGraph
+{
+public:
+    // function(begin, end) gets one chunk of the task's range
+    typedef std::function<void(size_t begin, size_t end)> RangeFunction;
+
+    TaskGraph();
+
+    TaskResource addResource(const char* name);
+
+    // A single stage, run once per frame
+    TaskId addTask(const char* name, const std::function<void()>& function);
+
+    // A stage over count items, split into chunks of at most grain items
+    TaskId addTask(const char* name, const RangeFunction& function, size_t count, size_t grain);
+
+    void reads(TaskId task, TaskResource resource);
+    void writes(TaskId task, TaskResource resource);
+
+    // The range can change between runs, e.g. when entities were added
+    void setRange(TaskId task, size_t count);
+
+    // Derives the dependencies, call after the last task and before run()
+    void compile();
+
+    // Runs every task once and returns when they are all done. The calling thread
+    // runs jobs too while it waits.
+    void run(JobSystem& jobs);
+
+    // Graphviz: tasks as nodes, dependencies as edges labelled with the resource
+    bool writeDot(const char* path) const;
+
+    size_t taskCount() const { return mTasks.size(); }
+
+private:
+    struct Task
+    {
+        TaskGraph* graph;
+        TaskId id;
+        const char* name;
+        RangeFunction function;
+        size_t count;
+        size_t grain;
+        std::vector<TaskResource> reads;
+        std::vector<TaskResource> writes;
+
+        // compiled
+        std::vector<TaskId> successors;
+        std::vector<TaskResource> successorResources;   // what each successor waits for, for the export
+        int predecessorCount;
+
+        // per run
+        std::atomic<int> waitingOn;
+        std::atomic<size_t> chunksLeft;
+    };
+
+    static void runChunk(void* data, size_t index);
+    void release(TaskId task);
+    void completeTask(TaskId task);
+    void addDependency(TaskId from, TaskId to, TaskResource resource);
+
+    // Jobs point at their task, a deque never moves what it already holds
+    std::deque<Task> mTasks;
+    std::vector<const char*> mResources;
+    JobSystem* mJobs;
+    std::atomic<int> mTasksLeft;
+};
@@ -0,0 +1,77 @@
+//
+// COMP 371 Labs Framework
+//
+// Translation, rotation and scale transforms -- COMP371 Assignment 2
+//
+// Keeps the three parts apart instead of accumulating them in a mat4. Each edit
+// touches only its own part and the rotation is renormalized, so repeated input
+// does not drift the way a matrix multiplied in place every frame does. The matrix
+// is built in one pass when it is needed. 40 bytes instead of 64.
+
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+
+struct Transform
+{
+    glm::vec3 translation;
+    glm::quat rotation;     // unit length
+    glm::vec3 scale;
+
+    Transform()
+        : translation(0.0f), rotation(1.0f, 0.0f, 0.0f, 0.0f), scale(1.0f)
+    {
+    }
+
+    Transform(const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale)
+        : translation(translation), rotation(rotation), scale(scale)
+    {
+    }
+};
+
+inline bool operator==(const Transform& a, const Transform& b)
+{
+    return a.translation == b.translation && a.rotation == b.rotation && a.scale == b.scale;
+}
+
+inline bool operator!=(const Transform& a, const Transform& b) { return !(a == b); }
+
+
+// T * R * S written straight into the columns, no intermediate matrices
+inline glm::mat4 toMatrix(const Transform& transform)
+{
+    const glm::quat& q = transform.rotation;
+    float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+    float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+    float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+
+    glm::mat4 matrix;
+    matrix[0] = glm::vec4((1.0f - 2.0f * (yy + zz)) * transform.scale.x, 2.0f * (xy + wz) * transform.scale.x, 2.0f * (xz - wy) * transform.scale.x, 0.0f);
+    matrix[1] = glm::vec4(2.0f * (xy - wz) * transform.scale.y, (1.0f - 2.0f * (xx + zz)) * transform.scale.y, 2.0f * (yz + wx) * transform.scale.y, 0.0f);
+    matrix[2] = glm::vec4(2.0f * (xz + wy) * transform.scale.z, 2.0f * (yz - wx) * transform.scale.z, (1.0f - 2.0f * (xx + yy)) * transform.scale.z, 0.0f);
+    matrix[3] = glm::vec4(transform.translation, 1.0f);
+    return matrix;
+}
+
+
+// The in place edits below match glm::translate / rotate / scale applied to toMatrix(transform)
+
+// Moves along the transform's own axes, in its scaled units
+inline void translateLocal(Transform& transform, const glm::vec3& offset)
+{
+    transform.translation += transform.rotation * (transform.scale * offset);
+}
+
+// Turns around an axis given in the transform's own space. Exact for uniform scale,
+// a non uniform scale would need shear which TRS cannot hold.
+inline void rotateLocal(Transform& transform, float angle, const glm::vec3& axis)
+{
+    transform.rotation = glm::normalize(transform.rotation * glm::angleAxis(angle, glm::normalize(axis)));
+}
+
+inline void scaleLocal(Transform& transform, const glm::vec3& factor)
+{
+    transform.scale *= factor;
+}
@@ -0,0 +1,369 @@
+//
+// COMP 371 Labs Framework
+//
+// Session recording to a Y4M video -- COMP371 Assignment 2
+
+#include "VideoRecorder.h"
+#include "AllocationTracker.h"
+
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LIGMA_VIDEO_SSE 1
+#include <emmintrin.h>
+#else
+#define LIGMA_VIDEO_SSE 0
+#endif
+
+
+// Full range BT.601 in 8.8 fixed point, what the C420jpeg colour space expects
+static const int sYCoefficients[3] = { 77, 150, 29 };
+static const int sUCoefficients[3] = { -43, -85, 128 };
+static const int sVCoefficients[3] = { 128, -107, -21 };
+
+
+static unsigned char clampByte(int value)
+{
+    return (unsigned char)(value < 0 ? 0 : value > 255 ? 255 : value);
+}
+
+
+static unsigned char lumaOf(const unsigned char* p)
+{
+    return clampByte((sYCoefficients[0] * p[0] + sYCoefficients[1] * p[1] + sYCoefficients[2] * p[2] + 128) >> 8);
+}
+
+
+#if LIGMA_VIDEO_SSE
+// The dot product of each pixel with the coefficients, pixels p0..p3 as 16 bit RGBA in lo (p0, p1) and hi (p2, p3)
+static __m128i dotPixels(__m128i lo, __m128i hi, __m128i coefficients)
+{
+    __m128 a = _mm_castsi128_ps(_mm_madd_epi16(lo, coefficients));
+    __m128 b = _mm_castsi128_ps(_mm_madd_epi16(hi, coefficients));
+
+    // madd leaves (r + g, b + a) pairs, add each pair up
+    __m128i even = _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+    __m128i odd = _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+    return _mm_add_epi32(even, odd);
+}
+
+// Four 32 bit values to four clamped bytes
+static int packBytes(__m128i values)
+{
+    __m128i words = _mm_packs_epi32(values, values);
+    return _mm_cvtsi128_si32(_mm_packus_epi16(words, words));
+}
+#endif
+
+
+// One output row of luma from one RGBA row
+static void convertLumaRow(const unsigned char* rgba, unsigned char* luma, int width)
+{
+    int x = 0;
+#if LIGMA_VIDEO_SSE
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i coefficients = _mm_setr_epi16(77, 150, 29, 0, 77, 150, 29, 0);
+    const __m128i rounding = _mm_set1_epi32(128);
+    for (; x + 4 <= width; x += 4)
+    {
+        __m128i pixels = _mm_loadu_si128((const __m128i*)(rgba + x * 4));
+        __m128i y = dotPixels(_mm_unpacklo_epi8(pixels, zero), _mm_unpackhi_epi8(pixels, zero), coefficients);
+        int bytes = packBytes(_mm_srai_epi32(_mm_add_epi32(y, rounding), 8));
+        memcpy(luma + x, &bytes, 4);
+    }
+#endif
+    for (; x < width; ++x)
+        luma[x] = lumaOf(rgba + x * 4);
+}
+
+
+// One output row of each chroma plane from two RGBA rows, each chroma sample covers 2x2 pixels
+static void convertChromaRow(const unsigned char* rgba0, const unsigned char* rgba1, unsigned char* u, unsigned char* v, int chromaWidth)
+{
+    int x = 0;
+#if LIGMA_VIDEO_SSE
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i uCoefficients = _mm_setr_epi16(-43, -85, 128, 0, -43, -85, 128, 0);
+    const __m128i vCoefficients = _mm_setr_epi16(128, -107, -21, 0, 128, -107, -21, 0);
+    const __m128i rounding = _mm_set1_epi32(128);
+    const __m128i offset = _mm_set1_epi32(128);
+    for (; x + 4 <= chromaWidth; x += 4)
+    {
+        // average the two rows, then neighbouring pixels, which leaves the 2x2 averages in pixels 0 and 2
+        __m128i blocks[2];
+        for (int half = 0; half < 2; ++half)
+        {
+            int offsetBytes = (x * 2 + half * 4) * 4;
+            __m128i rows = _mm_avg_epu8(_mm_loadu_si128((const __m128i*)(rgba0 + offsetBytes)),
+                                        _mm_loadu_si128((const __m128i*)(rgba1 + offsetBytes)));
+            __m128i averaged = _mm_avg_epu8(rows, _mm_srli_si128(rows, 4));
+            blocks[half] = _mm_unpacklo_epi8(_mm_shuffle_epi32(averaged, _MM_SHUFFLE(3, 1, 2, 0)), zero);
+        }
+
+        __m128i uValues = _mm_add_epi32(_mm_srai_epi32(_mm_add_epi32(dotPixels(blocks[0], blocks[1], uCoefficients), rounding), 8), offset);
+        __m128i vValues = _mm_add_epi32(_mm_srai_epi32(_mm_add_epi32(dotPixels(blocks[0], blocks[1], vCoefficients), rounding), 8), offset);
+        int uBytes = packBytes(uValues);
+        int vBytes = packBytes(vValues);
+        memcpy(u + x, &uBytes, 4);
+        memcpy(v + x, &vBytes, 4);
+    }
+#endif
+    for (; x < chromaWidth; ++x)
+    {
+        const unsigned char* a = rgba0 + x * 8;
+        const unsigned char* b = rgba1 + x * 8;
+        int rgb[3];
+        for (int channel = 0; channel < 3; ++channel)
+            rgb[channel] = (a[channel] + a[channel + 4] + b[channel] + b[channel + 4] + 2) >> 2;
+
+        u[x] = clampByte(((sUCoefficients[0] * rgb[0] + sUCoefficients[1] * rgb[1] + sUCoefficients[2] * rgb[2] + 128) >> 8) + 128);
+        v[x] = clampByte(((sVCoefficients[0] * rgb[0] + sVCoefficients[1] * rgb[1] + sVCoefficients[2] * rgb[2] + 128) >> 8) + 128);
+    }
+}
+
+
+// Extends the file on disk without moving the write position
+static bool reserveFileSize(FILE* file, long long size)
+{
+#ifdef _WIN32
+    return _chsize_s(_fileno(file), size) == 0;
+#else
+    return posix_fallocate(fileno(file), 0, (off_t)size) == 0;
+#endif
+}
+
+static bool truncateFile(FILE* file, long long size)
+{
+    fflush(file);
+#ifdef _WIN32
+    return _chsize_s(_fileno(file), size) == 0;
+#else
+    return ftruncate(fileno(file), (off_t)size) == 0;
+#endif
+}
+
+
+VideoRecorder::VideoRecorder()
+    : mFramesPerSecond(60), mWidth(0), mHeight(0), mDroppedReadback(0), mDroppedWriter(0), mDroppedSize(0),
+      mFile(NULL), mFileSize(0), mFileReserved(0), mStopping(false), mFramesWritten(0)
+{
+}
+
+
+VideoRecorder::~VideoRecorder()
+{
+    destroy();
+}
+
+
+bool VideoRecorder::create(const char* path, int framesPerSecond)
+{
+    destroy();
+
+    mFile = fopen(path, "wb");
+    if (mFile == NULL)
+    {
+        std::cerr << "VideoRecorder: could not open " << path << " for writing" << std::endl;
+        return false;
+    }
+
+    // big writes straight from the conversion buffer, stdio buffering would only add a copy
+    setvbuf(mFile, NULL, _IONBF, 0);
+
+    mPath = path;
+    mFramesPerSecond = framesPerSecond > 0 ? framesPerSecond : 60;
+    mWidth = mHeight = 0;
+    mDroppedReadback = mDroppedWriter = mDroppedSize = 0;
+    mFileSize = mFileReserved = 0;
+    mStopping = false;
+    mFramesWritten = 0;
+
+    mFreeFrames.clear();
+    mQueuedFrames.clear();
+    mFreeFrames.reserve(FrameBufferCount);
+    mQueuedFrames.reserve(FrameBufferCount);
+    for (int i = 0; i < FrameBufferCount; ++i)
+        mFreeFrames.push_back(i);
+
+    mReadback.create();
+    mWriter = std::thread(&VideoRecorder::writerLoop, this);
+    return true;
+}
+
+
+void VideoRecorder::destroy()
+{
+    if (!mWriter.joinable())
+        return;
+
+    // the last couple of frames are worth waiting for on the way out
+    mReadback.flush([this](const unsigned char* rgba, unsigned int, int width, int height)
+    {
+        queueFrame(rgba, width, height);
+    });
+    mReadback.destroy();
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mWorkAvailable.notify_one();
+    mWriter.join();
+
+    truncateFile(mFile, mFileSize);
+    fclose(mFile);
+    mFile = NULL;
+
+    std::cout << "VideoRecorder: " << mFramesWritten << " frames written to " << mPath << ", "
+              << mDroppedReadback + mDroppedWriter + mDroppedSize << " dropped (" << mDroppedReadback << " readback busy, "
+              << mDroppedWriter << " writer behind, " << mDroppedSize << " resized)" << std::endl;
+}
+
+
+void VideoRecorder::endFrame(unsigned int frameNumber, int width, int height)
+{
+    mReadback.collect(frameNumber, false, [this](const unsigned char* rgba, unsigned int, int readWidth, int readHeight)
+    {
+        queueFrame(rgba, readWidth, readHeight);
+    });
+
+    if (!mReadback.read(frameNumber, width, height))
+        mDroppedReadback++;
+}
+
+
+unsigned int VideoRecorder::framesWritten()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mFramesWritten;
+}
+
+
+unsigned int VideoRecorder::framesDropped()
+{
+    return mDroppedReadback + mDroppedWriter + mDroppedSize;
+}
+
+
+void VideoRecorder::queueFrame(const unsigned char* rgba, int width, int height)
+{
+    if (mWidth == 0)
+    {
+        mWidth = width & ~1;
+        mHeight = height & ~1;
+    }
+    if ((width & ~1) != mWidth || (height & ~1) != mHeight)
+    {
+        mDroppedSize++;
+        return;
+    }
+
+    int index = -1;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (!mFreeFrames.empty())
+        {
+            index = mFreeFrames.back();
+            mFreeFrames.pop_back();
+        }
+    }
+    if (index < 0)
+    {
+        if (mDroppedWriter++ == 0)
+            std::cerr << "VideoRecorder: the writer cannot keep up, dropping frames" << std::endl;
+        return;
+    }
+
+    // the buffer belongs to this thread until it is queued, only the first frames allocate
+    Frame& frame = mFrames[index];
+    frame.width = width;
+    frame.height = height;
+    frame.rgba.assign(rgba, rgba + (size_t)width * height * 4);
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mQueuedFrames.push_back(index);
+    }
+    mWorkAvailable.notify_one();
+}
+
+
+void VideoRecorder::writerLoop()
+{
+    AllocationTracker::setThreadName("video writer");
+
+    for (;;)
+    {
+        int index;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mWorkAvailable.wait(lock, [this] { return mStopping || !mQueuedFrames.empty(); });
+            if (mQueuedFrames.empty())
+                return;
+
+            index = mQueuedFrames.front();
+            mQueuedFrames.erase(mQueuedFrames.begin());
+        }
+
+        writeFrame(mFrames[index]);
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        mFreeFrames.push_back(index);
+        mFramesWritten++;
+    }
+}
+
+
+void VideoRecorder::writeFrame(const Frame& frame)
+{
+    if (mFileSize == 0)
+    {
+        char header[128];
+        int length = snprintf(header, sizeof(header), "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", mWidth, mHeight, mFramesPerSecond);
+        fwrite(header, 1, length, mFile);
+        mFileSize = length;
+    }
+
+    // "FRAME\n", then the Y, U and V planes
+    static const char frameHeader[] = "FRAME\n";
+    const size_t headerSize = sizeof(frameHeader) - 1;
+    const int chromaWidth = mWidth / 2;
+    const int chromaHeight = mHeight / 2;
+    const size_t lumaSize = (size_t)mWidth * mHeight;
+    const size_t chromaSize = (size_t)chromaWidth * chromaHeight;
+    mYuv.resize(headerSize + lumaSize + 2 * chromaSize);
+    memcpy(&mYuv[0], frameHeader, headerSize);
+
+    unsigned char* luma = &mYuv[headerSize];
+    unsigned char* u = luma + lumaSize;
+    unsigned char* v = u + chromaSize;
+    const size_t stride = (size_t)frame.width * 4;
+    for (int y = 0; y < mHeight; y += 2)
+    {
+        // GL rows start at the bottom
+        const unsigned char* row0 = &frame.rgba[(frame.height - 1 - y) * stride];
+        const unsigned char* row1 = &frame.rgba[(frame.height - 2 - y) * stride];
+        convertLumaRow(row0, luma + (size_t)y * mWidth, mWidth);
+        convertLumaRow(row1, luma + (size_t)(y + 1) * mWidth, mWidth);
+        convertChromaRow(row0, row1, u + (size_t)(y / 2) * chromaWidth, v + (size_t)(y / 2) * chromaWidth, chromaWidth);
+    }
+
+    if (mFileSize + (long long)mYuv.size() > mFileReserved)
+    {
+        // not fatal when it fails, the writes extend the file as they go
+        mFileReserved = mFileSize + (long long)mYuv.size() * GrowFrames;
+        reserveFileSize(mFile, mFileReserved);
+    }
+
+    if (fwrite(&mYuv[0], 1, mYuv.size(), mFile) != mYuv.size())
+        std::cerr << "VideoRecorder: failed writing " << mPath << std::endl;
+    mFileSize += mYuv.size();
+}
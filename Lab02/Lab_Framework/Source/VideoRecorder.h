@@ -0,0 +1,85 @@
+//
+// COMP 371 Labs Framework
+//
+// Session recording to a Y4M video -- COMP371 Assignment 2
+//
+// Every frame is read back through PixelReadback and, when it is ready, copied into
+// one of a few frame buffers owned by a writer thread. That thread converts it to
+// 4:2:0 YUV (SSE2 when the compiler targets it) and appends it to the file, which
+// is grown ahead of the writes in large steps instead of a frame at a time. Nothing
+// on the render thread ever waits: a frame whose readback buffer is still busy, or
+// that finds every frame buffer queued for writing, is dropped and counted.
+// Y4M has a fixed frame rate, so the video runs fast where frames were dropped.
+
+#pragma once
+
+#include "PixelReadback.h"
+
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+class VideoRecorder
+{
+public:
+    static const int FrameBufferCount = 4;  // frames that can wait for the writer
+    static const int GrowFrames = 120;      // the file is extended this many frames at a time
+
+    VideoRecorder();
+    ~VideoRecorder();
+
+    bool create(const char* path, int framesPerSecond);
+
+    // Writes out what is still in flight, trims the file and prints a summary
+    void destroy();
+
+    // Call once per frame after rendering and before swapping. The first frame fixes the
+    // video size (rounded down to even), frames of another size are dropped.
+    void endFrame(unsigned int frameNumber, int width, int height);
+
+    unsigned int framesWritten();
+    unsigned int framesDropped();
+
+private:
+    struct Frame
+    {
+        std::vector<unsigned char> rgba;    // bottom row first, as GL reads it
+        int width;
+        int height;
+    };
+
+    void queueFrame(const unsigned char* rgba, int width, int height);
+    void writerLoop();
+    void writeFrame(const Frame& frame);
+
+    PixelReadback mReadback;
+    std::string mPath;
+    int mFramesPerSecond;
+    int mWidth;     // 0 until the first frame
+    int mHeight;
+
+    // render thread only
+    unsigned int mDroppedReadback;  // the readback ring was still busy
+    unsigned int mDroppedWriter;    // every frame buffer was waiting for the writer
+    unsigned int mDroppedSize;      // the framebuffer was resized
+
+    // writer thread only
+    FILE* mFile;
+    long long mFileSize;
+    long long mFileReserved;
+    std::vector<unsigned char> mYuv;
+
+    // shared
+    std::thread mWriter;
+    std::mutex mMutex;
+    std::condition_variable mWorkAvailable;
+    Frame mFrames[FrameBufferCount];
+    std::vector<int> mFreeFrames;
+    std::vector<int> mQueuedFrames;     // oldest first, never longer than FrameBufferCount
+    bool mStopping;
+    unsigned int mFramesWritten;
+};